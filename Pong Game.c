@@ -8,9 +8,9 @@
  */ 
 
 #include "game.h"
-#include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
 #include "display.h"
 #include "terminalio.h"
 #include "timer0.h"
@@ -40,15 +40,237 @@ int player2_score = 0 ;
 int player1_rally_number = 0;
 int player2_rally_number = 0;
 
+// Seed for the ball direction generator. If it is 0 (the default) each game
+// is seeded from the timer instead, otherwise every game with the same seed
+// makes the same choices.
+uint16_t game_seed = 0;
+
+// State of the xorshift generator used to choose ball directions. It is
+// seeded once per game and never 0.
+static uint16_t game_random_state = 1;
+
+// Returns the next number from the game's 16-bit xorshift generator. This
+// costs a few shifts, where rand() needs 32-bit multiplies and divides on
+// the AVR.
+static uint16_t game_random(void) {
+	game_random_state ^= game_random_state << 7;
+	game_random_state ^= game_random_state >> 9;
+	game_random_state ^= game_random_state << 8;
+	return game_random_state;
+}
+
+// Returns a random number from 0 to limit - 1, using an 8 by 8 bit multiply
+// of the generator's high byte rather than a division.
+static uint8_t game_random_below(uint8_t limit) {
+	return ((game_random() >> 8) * limit) >> 8;
+}
+
+
+// Frame buffer for the LED matrix. Game code draws into the *_frame arrays
+// and flush_frame() sends only the squares and pixels that differ from the
+// *_shown arrays, which hold what the matrix displays, so erasing and
+// redrawing a pixel in the same frame costs nothing and doesn't flicker. The
+// game board holds objects (sent with update_square_colour()) and the rally
+// counter columns hold colours (sent with ledmatrix_update_pixel()). Each
+// column has a dirty bit so unchanged columns are skipped. The frame is
+// flushed once per tick, at the end of update_ball_position(), so a paddle
+// move shows up together with the next ball move.
+#define PLAYER_1_COUNTER 0
+#define PLAYER_2_COUNTER 1
+static uint8_t board_frame[BOARD_WIDTH][BOARD_HEIGHT];
+static uint8_t board_shown[BOARD_WIDTH][BOARD_HEIGHT];
+static PixelColour counter_frame[2][MATRIX_NUM_ROWS];
+static PixelColour counter_shown[2][MATRIX_NUM_ROWS];
+static uint16_t dirty_board_columns = 0;
+static uint8_t dirty_counter_columns = 0;
+
+#if BOARD_WIDTH > 16
+#error "dirty_board_columns needs a bit for each board column"
+#endif
+
+// Scoreboard on the serial terminal. scoreboard_text holds what should be
+// shown and scoreboard_shown what has been sent, and flush_scoreboard()
+// sends only the characters that differ. A player's score line appears once
+// they have scored. The physics update only marks the scoreboard changed.
+#define SCOREBOARD_ROWS 2
+#define SCOREBOARD_COLUMNS 20
+#define SCOREBOARD_X 10
+#define SCOREBOARD_Y 13
+static char scoreboard_text[SCOREBOARD_ROWS][SCOREBOARD_COLUMNS];
+static char scoreboard_shown[SCOREBOARD_ROWS][SCOREBOARD_COLUMNS];
+static uint8_t scoreboard_changed = 0;
+static uint8_t show_cursor_pending = 0;
+
+// Ring buffer of bytes waiting to go to the terminal. flush_scoreboard()
+// only queues what fits, leaving the rest for the next frame, and sends at
+// most TERMINAL_BYTES_PER_FRAME bytes each frame, so a frame never waits for
+// the UART to catch up.
+#define TERMINAL_QUEUE_SIZE 64  // Must be a power of two.
+#define TERMINAL_BYTES_PER_FRAME 16
+#define CURSOR_MOVE_LENGTH 8  // Longest "ESC[row;colH" sequence.
+static char terminal_queue[TERMINAL_QUEUE_SIZE];
+static uint8_t terminal_queue_head = 0;  // Next byte to send.
+static uint8_t terminal_queue_length = 0;
 
 void draw_player_paddle(uint8_t player_to_draw);
 void erase_player_paddle(uint8_t player_to_draw);
 
+// Add bytes to the end of the terminal queue. The caller makes sure they fit.
+static void queue_terminal_bytes(const char *bytes, uint8_t length) {
+	for (uint8_t i = 0; i < length; i++) {
+		uint8_t tail = (terminal_queue_head + terminal_queue_length) & (TERMINAL_QUEUE_SIZE - 1);
+		terminal_queue[tail] = bytes[i];
+		terminal_queue_length++;
+	}
+}
+
+// Send up to TERMINAL_BYTES_PER_FRAME bytes from the terminal queue.
+static void send_terminal_bytes(void) {
+	for (uint8_t i = 0; i < TERMINAL_BYTES_PER_FRAME && terminal_queue_length > 0; i++) {
+		putchar(terminal_queue[terminal_queue_head]);
+		terminal_queue_head = (terminal_queue_head + 1) & (TERMINAL_QUEUE_SIZE - 1);
+		terminal_queue_length--;
+	}
+}
+
+// Render the score lines into scoreboard_text.
+static void render_scoreboard(void) {
+	int scores[SCOREBOARD_ROWS] = {player1_score, player2_score};
+	for (uint8_t row = 0; row < SCOREBOARD_ROWS; row++) {
+		memset(scoreboard_text[row], ' ', SCOREBOARD_COLUMNS);
+		if (scores[row] > 0) {
+			char line[SCOREBOARD_COLUMNS + 1];
+			int length = snprintf(line, sizeof(line), "Player %d Score: %d", row + 1, scores[row]);
+			memcpy(scoreboard_text[row], line, length < SCOREBOARD_COLUMNS ? length : SCOREBOARD_COLUMNS);
+		}
+	}
+}
+
+// Queue the scoreboard characters that differ from what the terminal shows,
+// each run of them after a cursor move, then send the next bytes of the
+// queue. Called once per tick, after the frame is flushed at the end of
+// update_ball_position().
+static void flush_scoreboard(void) {
+	if (scoreboard_changed) {
+		render_scoreboard();
+		scoreboard_changed = 0;
+	}
+	
+	// Show the cursor after a point, as the game always has.
+	if (show_cursor_pending && TERMINAL_QUEUE_SIZE - terminal_queue_length >= 6) {
+		queue_terminal_bytes("\x1b[?25h", 6);
+		show_cursor_pending = 0;
+	}
+	
+	for (uint8_t row = 0; row < SCOREBOARD_ROWS; row++) {
+		uint8_t column = 0;
+		while (column < SCOREBOARD_COLUMNS) {
+			if (scoreboard_text[row][column] == scoreboard_shown[row][column]) {
+				column++;
+				continue;
+			}
+			// Extend the run over matching characters when resending them is
+			// shorter than another cursor move.
+			uint8_t run = 1;
+			for (uint8_t next = column + 1; next < SCOREBOARD_COLUMNS
+					&& next < column + run + CURSOR_MOVE_LENGTH; next++) {
+				if (scoreboard_text[row][next] != scoreboard_shown[row][next]) {
+					run = next - column + 1;
+				}
+			}
+			
+			// Leave what doesn't fit for the next frame.
+			if (TERMINAL_QUEUE_SIZE - terminal_queue_length < CURSOR_MOVE_LENGTH + run) {
+				send_terminal_bytes();
+				return;
+			}
+			char move[CURSOR_MOVE_LENGTH + 1];
+			int length = snprintf(move, sizeof(move), "\x1b[%d;%dH",
+					SCOREBOARD_Y + row, SCOREBOARD_X + column);
+			queue_terminal_bytes(move, length);
+			queue_terminal_bytes(&scoreboard_text[row][column], run);
+			memcpy(&scoreboard_shown[row][column], &scoreboard_text[row][column], run);
+			column += run;
+		}
+	}
+	send_terminal_bytes();
+}
+
+// Draw an object on a square of the game board in the next frame.
+static void draw_square(int8_t x, int8_t y, uint8_t object) {
+	if (x < 0 || x >= BOARD_WIDTH || y < 0 || y >= BOARD_HEIGHT) {
+		return;
+	}
+	board_frame[x][y] = object;
+	dirty_board_columns |= (uint16_t)1 << x;
+}
+
+// Colour a pixel of a player's rally counter column in the next frame.
+static void draw_counter_pixel(uint8_t counter, uint8_t y, PixelColour colour) {
+	if (y >= MATRIX_NUM_ROWS) {
+		return;
+	}
+	counter_frame[counter][y] = colour;
+	dirty_counter_columns |= 1 << counter;
+}
+
+// Send the changes made to the frame since the last flush to the display.
+static void flush_frame(void) {
+	for (int8_t x = 0; dirty_board_columns != 0; x++, dirty_board_columns >>= 1) {
+		if (!(dirty_board_columns & 1)) {
+			continue;
+		}
+		for (int8_t y = 0; y < BOARD_HEIGHT; y++) {
+			if (board_frame[x][y] != board_shown[x][y]) {
+				board_shown[x][y] = board_frame[x][y];
+				update_square_colour(x, y, board_frame[x][y]);
+			}
+		}
+	}
+	
+	for (uint8_t counter = PLAYER_1_COUNTER; counter <= PLAYER_2_COUNTER; counter++) {
+		if (!(dirty_counter_columns & (1 << counter))) {
+			continue;
+		}
+		uint8_t column = counter == PLAYER_1_COUNTER ? 0 : MATRIX_NUM_COLUMNS - 1;
+		for (uint8_t y = 0; y < MATRIX_NUM_ROWS; y++) {
+			if (counter_frame[counter][y] != counter_shown[counter][y]) {
+				counter_shown[counter][y] = counter_frame[counter][y];
+				ledmatrix_update_pixel(column, y, counter_frame[counter][y]);
+			}
+		}
+	}
+	dirty_counter_columns = 0;
+}
+
 // Initialise the player paddles, ball and display to start a game of PONG.
 void initialise_game(void) {
 	
-	// initialise the display we are using.
+	// initialise the display we are using. It starts out blank, and so does
+	// the frame.
 	initialise_display();
+	for (int8_t x = 0; x < BOARD_WIDTH; x++) {
+		for (int8_t y = 0; y < BOARD_HEIGHT; y++) {
+			board_frame[x][y] = EMPTY_SQUARE;
+			board_shown[x][y] = EMPTY_SQUARE;
+		}
+	}
+	for (uint8_t y = 0; y < MATRIX_NUM_ROWS; y++) {
+		counter_frame[PLAYER_1_COUNTER][y] = COLOUR_BLACK;
+		counter_frame[PLAYER_2_COUNTER][y] = COLOUR_BLACK;
+		counter_shown[PLAYER_1_COUNTER][y] = COLOUR_BLACK;
+		counter_shown[PLAYER_2_COUNTER][y] = COLOUR_BLACK;
+	}
+	dirty_board_columns = 0;
+	dirty_counter_columns = 0;
+	
+	// The scoreboard starts out blank too, with nothing left to send from the
+	// last game.
+	memset(scoreboard_text, ' ', sizeof(scoreboard_text));
+	memset(scoreboard_shown, ' ', sizeof(scoreboard_shown));
+	scoreboard_changed = 0;
+	terminal_queue_head = 0;
+	terminal_queue_length = 0;
 
 	// Start players in the middle of the board
 	player_y_coordinates[PLAYER_1] = BOARD_HEIGHT / 2 - 1;
@@ -59,15 +281,19 @@ void initialise_game(void) {
 	
 	//Have the ball travel in a random direction when the game is started.
 	
-	//Generate a random number:
-	srand(get_current_time()); //Seed the random number generator.
+	//Seed the game's random number generator, once for the whole game.
+	uint32_t seed = game_seed ? game_seed : get_current_time();
+	game_random_state = (uint16_t)(seed ^ (seed >> 16));
+	if (game_random_state == 0) {
+		game_random_state = 1; //Xorshift never leaves 0.
+	}
 	
 	//Generate arrays with the possible direction factors for x and y:
 	int y_direction_array[] = {-1, 0 , 1};
 	int x_direction_array[] = {-1, 1};
 	
-	int random_number_y  = rand() % 3 ; //Selects a random number which is either 0,1,2
-	int random_number_x = rand() % 2;  //Selects two random numbers either 0,1.
+	int random_number_y  = game_random_below(3); //Selects a random number which is either 0,1,2
+	int random_number_x = game_random_below(2);  //Selects two random numbers either 0,1.
 	
 	int direction_number_x = x_direction_array[random_number_x] ; //Randomly select an array number from the x_direction_array.
 	int direction_number_y = y_direction_array [random_number_y] ; //Randomly select an array number from the y_direction_array.
@@ -78,7 +304,7 @@ void initialise_game(void) {
 		
 
 	// Clear the old ball
-	update_square_colour(ball_x, ball_y, EMPTY_SQUARE);
+	draw_square(ball_x, ball_y, EMPTY_SQUARE);
 	
 	// Reset ball position and direction
 	ball_x = BALL_START_X;
@@ -86,7 +312,8 @@ void initialise_game(void) {
 
 	
 	// Draw new ball
-	update_square_colour(ball_x, ball_y, BALL);
+	draw_square(ball_x, ball_y, BALL);
+	flush_frame();
 }
 
 // Draw player 1 or 2 on the game board at their current position (specified
@@ -97,7 +324,7 @@ void draw_player_paddle(uint8_t player_to_draw) {
 	int8_t player_y = player_y_coordinates[player_to_draw];
 
 	for (int y = player_y; y < player_y + PLAYER_HEIGHT; y++) {
-		update_square_colour(player_x, y, PLAYER);
+		draw_square(player_x, y, PLAYER);
 	}
 }
 
@@ -107,7 +334,7 @@ void erase_player_paddle(uint8_t player_to_draw) {
 	int8_t player_y = player_y_coordinates[player_to_draw];
 
 	for (int y = player_y; y < player_y + PLAYER_HEIGHT; y++) {
-		update_square_colour(player_x, y, EMPTY_SQUARE);
+		draw_square(player_x, y, EMPTY_SQUARE);
 	}
 }
 
@@ -158,7 +385,7 @@ void player_1_raller_counter(void){
 		player1_rally_number = 1; 
 		player1_display_index= 0; //Set the display index to 0 to later colour the first circle of the rally counter. 
 		for (board1_rally_display = 0; board1_rally_display <= 7; board1_rally_display ++){ //Clear the column and make it black. 
-			ledmatrix_update_pixel(0,board1_rally_display, COLOUR_BLACK);
+			draw_counter_pixel(PLAYER_1_COUNTER,board1_rally_display, COLOUR_BLACK);
 			}
 	}
 	
@@ -168,7 +395,7 @@ void player_1_raller_counter(void){
 	
 	//Colour the column up the player display index. 
 	for (board1_rally_display = 0; board1_rally_display <= player1_display_index; board1_rally_display ++){
-		ledmatrix_update_pixel(0,board1_rally_display, COLOUR_RALLY_COUNTER);
+		draw_counter_pixel(PLAYER_1_COUNTER,board1_rally_display, COLOUR_RALLY_COUNTER);
 	}
 	
 }
@@ -177,8 +404,8 @@ void player_1_raller_counter(void){
 
 void clear_rally1_counter(void){
 	player1_rally_number = 0; 
-	for (int board1_rally_display = 0; board1_rally_display <= 8; board1_rally_display ++){
-		ledmatrix_update_pixel(0,board1_rally_display, COLOUR_BLACK);
+	for (int board1_rally_display = 0; board1_rally_display < MATRIX_NUM_ROWS; board1_rally_display ++){
+		draw_counter_pixel(PLAYER_1_COUNTER,board1_rally_display, COLOUR_BLACK);
 	}
 }
 
@@ -199,7 +426,7 @@ void player_2_raller_counter(void){
 		player2_rally_number = 1;  //Reset the player rally number to 1;
 		player2_display_index= 0; //Set the display index to 0 to later colour the first circle of the rally counter.
 		for (board2_rally_display = 0; board2_rally_display <= 7; board2_rally_display ++){ //Clear the column and make it black. 
-			ledmatrix_update_pixel(MATRIX_NUM_COLUMNS-1,board2_rally_display, COLOUR_BLACK);
+			draw_counter_pixel(PLAYER_2_COUNTER,board2_rally_display, COLOUR_BLACK);
 		}
 	}
 	
@@ -208,15 +435,15 @@ void player_2_raller_counter(void){
 	}
 	
 	for (board2_rally_display = 0; board2_rally_display <= player2_display_index; board2_rally_display ++){
-		ledmatrix_update_pixel(MATRIX_NUM_COLUMNS-1,board2_rally_display, COLOUR_RALLY_COUNTER);
+		draw_counter_pixel(PLAYER_2_COUNTER,board2_rally_display, COLOUR_RALLY_COUNTER);
 	}
 	
 }
 
 void clear_rally2_counter(void){
 	player2_rally_number = 0;
-	for (int board1_rally_display = 0; board1_rally_display <= 8; board1_rally_display ++){
-		ledmatrix_update_pixel(MATRIX_NUM_COLUMNS-1,board1_rally_display, COLOUR_BLACK);
+	for (int board1_rally_display = 0; board1_rally_display < MATRIX_NUM_ROWS; board1_rally_display ++){
+		draw_counter_pixel(PLAYER_2_COUNTER,board1_rally_display, COLOUR_BLACK);
 	}
 }
 
@@ -233,7 +460,6 @@ void update_ball_position(void) {
 
 
 		//Generate a random number to then use to make a randomized x and y direction:
-		srand(get_current_time()); //Seed the random number generator.
 		
 		//Generate arrays with the possible direction factors for y, including for when it is bouncing off the top and bottom corners. 
 		int y_direction_array[] = {-1, 0 , 1};
@@ -243,8 +469,8 @@ void update_ball_position(void) {
 		//Generate an array with possible x-direction factors (either 1 or -1): 
 		int x_direction_array[] = {-1,1}; 
 		
-		int random_number_y  = rand() % 3 ; //Selects a random number which is either 0,1,2
-		int two_random_numbers = rand() % 2; //Selects a random number which is either 0 or 1.  
+		int random_number_y  = game_random_below(3); //Selects a random number which is either 0,1,2
+		int two_random_numbers = game_random_below(2); //Selects a random number which is either 0 or 1.  
 	
 		//Randomly select numbers from the array and set them to the y and x direction variables: 
 		int direction_number_y = y_direction_array [random_number_y] ; //Randomly select an array number from the y_direction_array.
@@ -324,9 +550,8 @@ void update_ball_position(void) {
 	//Point increment for player 2:
 	if (ball_x == PLAYER_1_X){
 		player2_score += 1; 
-		show_cursor();
-		move_terminal_cursor(10,14);
-		printf("Player 2 Score: %d", player2_score);
+		scoreboard_changed = 1; //flush_scoreboard() below shows the new score.
+		show_cursor_pending = 1;
 		clear_rally1_counter();
 		clear_rally2_counter(); 
 
@@ -335,9 +560,8 @@ void update_ball_position(void) {
 	//Point increment for player 1:
 	if (ball_x == PLAYER_2_X){
 		player1_score +=1;
-		show_cursor();
-		move_terminal_cursor(10,13);
-		printf("Player 1 Score: %d", player1_score);
+		scoreboard_changed = 1;
+		show_cursor_pending = 1;
 		clear_rally1_counter();
 		clear_rally2_counter();
 	}
@@ -345,7 +569,7 @@ void update_ball_position(void) {
 	//To connect to seven segment display. 
 
 	// Erase old ball
-	update_square_colour(ball_x, ball_y, EMPTY_SQUARE);
+	draw_square(ball_x, ball_y, EMPTY_SQUARE);
 	
 	// Assign new ball coordinates
 	ball_x = new_ball_x;
@@ -354,7 +578,9 @@ void update_ball_position(void) {
 	//Assign random ball direction: 
 	
 	// Draw new ball
-	update_square_colour(ball_x, ball_y, BALL);
+	draw_square(ball_x, ball_y, BALL);
+	flush_frame();
+	flush_scoreboard();
 	
 
 }
@@ -0,0 +1,20 @@
+/*
+ * display.h
+ *
+ * Host stand-in for the project's display.h: the board objects and their
+ * colours, and the display functions game.c calls.
+ */
+
+#ifndef DISPLAY_H_
+#define DISPLAY_H_
+#include <stdint.h>
+#include "pixel_colour.h"
+#define EMPTY_SQUARE 0
+#define PLAYER 1
+#define BALL 2
+#define COLOUR_PLAYER COLOUR_GREEN
+#define COLOUR_BALL COLOUR_RED
+#define COLOUR_RALLY_COUNTER COLOUR_YELLOW
+void initialise_display(void);
+void update_square_colour(uint8_t x, uint8_t y, uint8_t object);
+#endif
@@ -0,0 +1,25 @@
+/*
+ * game.h
+ *
+ * Host stand-in for the project's game.h, declaring what game.c and the
+ * host stubs use. Only for building "Pong Host Stubs.c" on Linux.
+ */
+
+#ifndef GAME_H_
+#define GAME_H_
+#include <stdint.h>
+#include "ledmatrix.h"
+#define PLAYER_1 0
+#define PLAYER_2 1
+#define BOARD_WIDTH (MATRIX_NUM_COLUMNS - 2)
+#define BOARD_HEIGHT MATRIX_NUM_ROWS
+#define PLAYER_1_X 0
+#define PLAYER_2_X (BOARD_WIDTH - 1)
+#define PLAYER_HEIGHT 2
+#define BALL_START_X (BOARD_WIDTH / 2)
+#define BALL_START_Y (BOARD_HEIGHT / 2)
+void initialise_game(void);
+void move_player_paddle(int8_t player, int8_t direction);
+void update_ball_position(void);
+uint8_t is_game_over(void);
+#endif
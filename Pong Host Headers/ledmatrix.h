@@ -0,0 +1,19 @@
+/*
+ * ledmatrix.h
+ *
+ * Host stand-in for the project's ledmatrix.h: the 16 x 8 LED matrix and
+ * the functions that update it.
+ */
+
+#ifndef LEDMATRIX_H_
+#define LEDMATRIX_H_
+#include <stdint.h>
+#include "pixel_colour.h"
+#define MATRIX_NUM_COLUMNS 16
+#define MATRIX_NUM_ROWS 8
+typedef PixelColour MatrixColumn[MATRIX_NUM_ROWS];
+void ledmatrix_setup(void);
+void ledmatrix_update_pixel(uint8_t x, uint8_t y, PixelColour pixel);
+void ledmatrix_update_column(uint8_t col, MatrixColumn data);
+void ledmatrix_clear(void);
+#endif
@@ -0,0 +1,16 @@
+/*
+ * pixel_colour.h
+ *
+ * Host stand-in for the project's pixel_colour.h: the colours an LED
+ * matrix pixel can be set to.
+ */
+
+#ifndef PIXEL_COLOUR_H_
+#define PIXEL_COLOUR_H_
+#include <stdint.h>
+typedef uint8_t PixelColour;
+#define COLOUR_BLACK 0x00
+#define COLOUR_RED 0x0F
+#define COLOUR_GREEN 0xF0
+#define COLOUR_YELLOW 0xFF
+#endif
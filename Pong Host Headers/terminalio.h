@@ -0,0 +1,17 @@
+/*
+ * terminalio.h
+ *
+ * Host stand-in for the project's terminalio.h: the terminal control
+ * functions game.c calls.
+ */
+
+#ifndef TERMINALIO_H_
+#define TERMINALIO_H_
+#include <stdint.h>
+void move_terminal_cursor(int x, int y);
+void normal_display_mode(void);
+void clear_terminal(void);
+void clear_to_end_of_line(void);
+void hide_cursor(void);
+void show_cursor(void);
+#endif
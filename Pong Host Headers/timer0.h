@@ -0,0 +1,13 @@
+/*
+ * timer0.h
+ *
+ * Host stand-in for the project's timer0.h: the millisecond clock kept by
+ * timer 0.
+ */
+
+#ifndef TIMER0_H_
+#define TIMER0_H_
+#include <stdint.h>
+void init_timer0(void);
+uint32_t get_current_time(void);
+#endif
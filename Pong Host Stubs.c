@@ -0,0 +1,264 @@
+/*
+ * host_stubs.c
+ *
+ * Host-side stand-ins for the board drivers used by game.c (display.h,
+ * ledmatrix.h, terminalio.h and timer0.h), so the game logic can run
+ * headless on Linux for testing and profiling. Each stand-in records what
+ * it is given into an in-memory buffer instead of driving the hardware, and
+ * a simulated millisecond clock replaces timer 0.
+ *
+ * Build from the top of the repository with the stand-in headers in
+ * "Pong Host Headers", for example:
+ *     gcc -O2 -DHOST_MAIN -I"Pong Host Headers" -o pong-host \
+ *         "Pong Game.c" "Pong Host Stubs.c"
+ * The project's own headers can be put on the include path instead.
+ * HOST_MAIN adds a main() that plays computer-controlled games for a given
+ * number of ticks and reports how fast they ran.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include "game.h"
+#include "display.h"
+#include "ledmatrix.h"
+#include "terminalio.h"
+#include "timer0.h"
+
+#define HOST_TERMINAL_ROWS 24
+#define HOST_TERMINAL_COLUMNS 80
+
+// Simulated time between ticks of the game loop, in milliseconds.
+#define HOST_TICK_MS 100
+
+// Game state from game.c
+extern int8_t ball_x;
+extern int8_t ball_y;
+extern int player1_score;
+extern int player2_score;
+extern uint16_t game_seed;
+
+// Objects drawn on the game board with update_square_colour().
+uint8_t host_board[BOARD_WIDTH][BOARD_HEIGHT];
+
+// Colours of the LED matrix pixels set with ledmatrix_update_pixel().
+PixelColour host_matrix[MATRIX_NUM_COLUMNS][MATRIX_NUM_ROWS];
+
+// Characters printed to the terminal, and the cursor position. The cursor
+// counts from 1, as for the escape sequence move_terminal_cursor() sends.
+char host_terminal[HOST_TERMINAL_ROWS][HOST_TERMINAL_COLUMNS];
+int host_cursor_x = 1;
+int host_cursor_y = 1;
+uint8_t host_cursor_visible = 0;
+
+// Number of calls to the stand-ins, and of writes they were given that
+// were outside the board, matrix or terminal. Cursor moves include those
+// sent as escape sequences, and host_terminal_bytes counts every byte
+// printed to the terminal.
+uint32_t host_square_updates = 0;
+uint32_t host_pixel_updates = 0;
+uint32_t host_cursor_moves = 0;
+uint32_t host_out_of_range_writes = 0;
+uint32_t host_terminal_bytes = 0;
+
+// An escape sequence printed to the terminal that hasn't ended yet.
+static char host_escape[16];
+static uint8_t host_escape_length = 0;
+
+// Simulated time in milliseconds, returned by get_current_time().
+uint32_t host_time = 0;
+
+// Number of games finished by host_tick().
+uint32_t host_games = 0;
+
+// State of the generator the computer players use to miss the ball. It is
+// separate from the game's generator so the players don't change its
+// choices.
+static uint32_t host_player_random = 2463534242u;
+
+
+void initialise_display(void) {
+	memset(host_board, EMPTY_SQUARE, sizeof(host_board));
+	memset(host_matrix, COLOUR_BLACK, sizeof(host_matrix));
+}
+
+void update_square_colour(uint8_t x, uint8_t y, uint8_t object) {
+	host_square_updates++;
+	if (x >= BOARD_WIDTH || y >= BOARD_HEIGHT) {
+		host_out_of_range_writes++;
+		return;
+	}
+	host_board[x][y] = object;
+}
+
+void ledmatrix_update_pixel(uint8_t x, uint8_t y, PixelColour pixel) {
+	host_pixel_updates++;
+	if (x >= MATRIX_NUM_COLUMNS || y >= MATRIX_NUM_ROWS) {
+		host_out_of_range_writes++;
+		return;
+	}
+	host_matrix[x][y] = pixel;
+}
+
+void move_terminal_cursor(int x, int y) {
+	// Anything printed before the move goes at the old cursor position.
+	fflush(stdout);
+	host_cursor_moves++;
+	host_cursor_x = x;
+	host_cursor_y = y;
+}
+
+void show_cursor(void) {
+	host_cursor_visible = 1;
+}
+
+void hide_cursor(void) {
+	host_cursor_visible = 0;
+}
+
+uint32_t get_current_time(void) {
+	return host_time;
+}
+
+// Acts on a complete escape sequence: a cursor move ("ESC[row;colH") or
+// showing or hiding the cursor. Others are ignored.
+static void host_terminal_escape(void) {
+	int row, column;
+	host_escape[host_escape_length] = '\0';
+	if (sscanf(host_escape, "\x1b[%d;%dH", &row, &column) == 2) {
+		host_cursor_moves++;
+		host_cursor_x = column;
+		host_cursor_y = row;
+	} else if (strcmp(host_escape, "\x1b[?25h") == 0) {
+		host_cursor_visible = 1;
+	} else if (strcmp(host_escape, "\x1b[?25l") == 0) {
+		host_cursor_visible = 0;
+	}
+}
+
+// Writes characters printed to stdout into host_terminal at the cursor.
+static ssize_t host_terminal_write(void *cookie, const char *buffer,
+		size_t size) {
+	(void)cookie;
+	host_terminal_bytes += size;
+	for (size_t i = 0; i < size; i++) {
+		if (host_escape_length > 0 || buffer[i] == '\x1b') {
+			// An escape sequence ends with a letter after "ESC[".
+			if (host_escape_length < sizeof(host_escape) - 1) {
+				host_escape[host_escape_length++] = buffer[i];
+			}
+			if (host_escape_length > 2 && ((buffer[i] >= 'A' && buffer[i] <= 'Z')
+					|| (buffer[i] >= 'a' && buffer[i] <= 'z'))) {
+				host_terminal_escape();
+				host_escape_length = 0;
+			}
+		} else if (buffer[i] == '\n') {
+			host_cursor_x = 1;
+			host_cursor_y++;
+		} else if (buffer[i] == '\r') {
+			host_cursor_x = 1;
+		} else {
+			if (host_cursor_y < 1 || host_cursor_y > HOST_TERMINAL_ROWS
+					|| host_cursor_x < 1
+					|| host_cursor_x > HOST_TERMINAL_COLUMNS) {
+				host_out_of_range_writes++;
+			} else {
+				host_terminal[host_cursor_y - 1][host_cursor_x - 1] = buffer[i];
+			}
+			host_cursor_x++;
+		}
+	}
+	return size;
+}
+
+// Sends everything the game prints to stdout into host_terminal, as the
+// board sends it to the serial terminal.
+void host_capture_terminal(void) {
+	memset(host_terminal, ' ', sizeof(host_terminal));
+	cookie_io_functions_t functions = {.write = host_terminal_write};
+	stdout = fopencookie(NULL, "w", functions);
+}
+
+// Returns the y coordinate of the lower pixel of a player's paddle, as drawn
+// on host_board, or -1 if it isn't drawn.
+int8_t host_paddle_y(uint8_t player) {
+	uint8_t x = player == PLAYER_1 ? PLAYER_1_X : PLAYER_2_X;
+	for (int8_t y = 0; y < BOARD_HEIGHT; y++) {
+		if (host_board[x][y] == PLAYER) {
+			return y;
+		}
+	}
+	return -1;
+}
+
+// Runs one tick of the game loop: each computer player moves its paddle
+// towards the ball, sometimes the wrong way, then the ball moves (which
+// flushes the frame and the scoreboard) and the simulated clock advances. A finished game
+// is restarted.
+void host_tick(void) {
+	for (uint8_t player = PLAYER_1; player <= PLAYER_2; player++) {
+		int8_t paddle_y = host_paddle_y(player);
+		host_player_random ^= host_player_random << 13;
+		host_player_random ^= host_player_random >> 17;
+		host_player_random ^= host_player_random << 5;
+		int8_t direction = ball_y > paddle_y ? 1 : -1;
+		if (host_player_random % 4 == 0) {
+			direction = -direction;
+		}
+		move_player_paddle(player, direction);
+	}
+
+	update_ball_position();
+	host_time += HOST_TICK_MS;
+
+	if (is_game_over()) {
+		host_games++;
+		player1_score = 0;
+		player2_score = 0;
+		initialise_game();
+	}
+}
+
+#ifdef HOST_MAIN
+// Plays games for the number of ticks given on the command line (10 million
+// by default), then reports the tick rate and what the game drew. An
+// optional second argument is the game seed, to replay the same games.
+int main(int argc, char *argv[]) {
+	uint32_t ticks = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000000;
+	game_seed = argc > 2 ? strtoul(argv[2], NULL, 10) : 0;
+	struct timespec start, end;
+
+	host_capture_terminal();
+	initialise_game();
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (uint32_t i = 0; i < ticks; i++) {
+		host_tick();
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	fflush(stdout);
+
+	double seconds = (end.tv_sec - start.tv_sec)
+			+ (end.tv_nsec - start.tv_nsec) / 1e9;
+	fprintf(stderr, "%lu ticks in %.3f s (%.0f ticks/s), %lu games\n",
+			(unsigned long)ticks, seconds, ticks / seconds,
+			(unsigned long)host_games);
+	fprintf(stderr, "%lu square updates, %lu pixel updates, %lu cursor moves, "
+			"%lu terminal bytes, %lu out of range writes\n",
+			(unsigned long)host_square_updates, (unsigned long)host_pixel_updates,
+			(unsigned long)host_cursor_moves, (unsigned long)host_terminal_bytes,
+			(unsigned long)host_out_of_range_writes);
+	for (int y = 0; y < HOST_TERMINAL_ROWS; y++) {
+		int length = HOST_TERMINAL_COLUMNS;
+		while (length > 0 && host_terminal[y][length - 1] == ' ') {
+			length--;
+		}
+		if (length > 0) {
+			fprintf(stderr, "%2d|%.*s\n", y + 1, length, host_terminal[y]);
+		}
+	}
+	return 0;
+}
+#endif
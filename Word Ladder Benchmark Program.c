@@ -0,0 +1,731 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+
+// Enum for benchmark exit statuses
+typedef enum {
+    BENCH_USAGE_ERROR = 9,
+    BENCH_DIRECTORY_ERROR = 3,
+    BENCH_FILE_ERROR = 11,
+    BENCH_EXEC_ERROR = 99  // Exit status of a child whose exec failed.
+} BenchExitStatus;
+
+// Enum for the classes of query in the fixed query mix
+typedef enum {
+    QUERY_REACHABLE = 0,
+    QUERY_UNREACHABLE = 1,
+    QUERY_LONG = 2,  // Endpoints of a double-sweep diameter estimate.
+    QUERY_LIMITED = 3,  // Reachable, but with --limit below the distance.
+    NUM_QUERY_CLASSES = 4
+} QueryClass;
+
+// Enum for the phases uqwordladder reports with --stats
+typedef enum {
+    PHASE_LOAD = 0,
+    PHASE_INDEX = 1,
+    PHASE_SEARCH = 2,
+    PHASE_PROCESS = 3,  // Whole process, measured by the benchmark itself.
+    NUM_PHASES = 4
+} BenchPhase;
+
+// Enum for benchmark limits and defaults
+typedef enum {
+    MIN_WORD_LENGTH = 2,
+    MAX_WORD_LENGTH = 9,
+    ALPHABET_SIZE = 26,
+    DEFAULT_SEED = 1,
+    DEFAULT_SIZE = 10000,
+    DEFAULT_LENGTH = 4,
+    DEFAULT_DENSITY = 5,  // Percent of all possible words in the dictionary.
+    DEFAULT_QUERIES = 25,  // Queries per query class.
+    PICK_ATTEMPTS = 64  // Random start words tried before giving up.
+} BenchDefaults;
+
+static const char *queryClassNames[NUM_QUERY_CLASSES] = {
+    "reachable", "unreachable", "long", "limited"
+};
+
+static const char *phaseNames[NUM_PHASES] = {
+    "load", "index", "search", "process"
+};
+
+// Struct for command line args
+typedef struct {
+    unsigned long seed;
+    int size;  // Number of words to generate.
+    int len;  // Length of every word.
+    int density;  // Percent of the possible words that are in the dictionary.
+    int queries;  // Queries per query class.
+    char *dir;  // Directory the generated dictionary is written to.
+    char *program;  // Name of the uqwordladder program to benchmark.
+} BenchArgs;
+
+// Struct holding a synthetic dictionary. Words are stored as numbers in base
+// `alphabet` so neighbours can be found with arithmetic instead of strings.
+typedef struct {
+    int numWords;
+    int len;
+    int alphabet;
+    uint64_t *codes;
+    uint64_t placeValues[MAX_WORD_LENGTH];
+    int *slots;  // Hash set over codes holding word index + 1, 0 if empty.
+    uint64_t slotMask;
+} Dictionary;
+
+// Struct holding one benchmark query
+typedef struct {
+    QueryClass queryClass;
+    int start;  // Word index of the start word.
+    int end;  // Word index of the end word.
+    int limit;  // Step limit, or 0 for no --limit argument.
+} Query;
+
+// Struct accumulating the measurements for one query class and phase
+typedef struct {
+    int samples;
+    long long ns;
+    long nodes;
+    long peakRss;  // Largest maxrss seen, in kilobytes.
+} PhaseTotals;
+
+// Struct accumulating the measurements for one query class
+typedef struct {
+    int queries;
+    int failures;  // Queries where the program died or reported no stats.
+    PhaseTotals phases[NUM_PHASES];
+} ClassTotals;
+
+/*
+usage_error():
+--------------
+Prints the correct usage of the benchmark program and exits with status 9.
+
+Returns: None (This function exits the program).
+*/
+void usage_error(void) {
+    fprintf(stderr,
+            "Usage: benchuqwordladder [--seed N] [--size N] [--len length] "
+            "[--density percent] [--queries N] [--dir dir] program\n");
+    exit(BENCH_USAGE_ERROR);
+}
+
+/*
+parse_number():
+---------------
+Converts a command line argument to a number, checking that it is made up
+only of digits and lies within the given range.
+
+arg1: str - The argument to convert.
+arg2: min - The smallest value accepted.
+arg3: max - The largest value accepted.
+
+Returns: The value of the argument.
+Errors: Calls usage_error() if the argument is not a number in range.
+*/
+unsigned long parse_number(char *str, unsigned long min, unsigned long max) {
+    char *end;
+    if (str[0] < '0' || str[0] > '9') {
+        usage_error();
+    }
+    errno = 0;
+    unsigned long value = strtoul(str, &end, 10);
+    if (errno != 0 || *end != '\0' || value < min || value > max) {
+        usage_error();
+    }
+    return value;
+}
+
+/*
+command_line_arguments():
+-------------------------
+Validates the command line and fills in the BenchArgs struct, using the
+defaults for any option that is not given. Every option may be given at
+most once and the program to benchmark must be the last argument.
+
+arg1: argc - The number of command-line arguments.
+arg2: argv[] - An array of command-line arguments.
+arg3: parameters - A pointer to the BenchArgs structure to populate.
+
+Returns: None
+Errors: Calls usage_error() if the command line is invalid.
+*/
+void command_line_arguments(int argc, char *argv[], BenchArgs *parameters) {
+    parameters->seed = DEFAULT_SEED;
+    parameters->size = DEFAULT_SIZE;
+    parameters->len = DEFAULT_LENGTH;
+    parameters->density = DEFAULT_DENSITY;
+    parameters->queries = DEFAULT_QUERIES;
+    parameters->dir = "./tmp";
+    parameters->program = NULL;
+
+    const char *options[] = {"--seed", "--size", "--len", "--density",
+            "--queries", "--dir"};
+    int numOptions = sizeof(options) / sizeof(options[0]);
+    bool given[sizeof(options) / sizeof(options[0])] = {false};
+
+    if (argc < 2 || argv[argc - 1][0] == '-') {
+        usage_error();
+    }
+    parameters->program = argv[argc - 1];
+
+    for (int i = 1; i < argc - 1; i++) {
+        int option = 0;
+        while (option < numOptions && strcmp(argv[i], options[option]) != 0) {
+            option++;
+        }
+        if (option == numOptions || given[option] || i + 1 >= argc - 1) {
+            usage_error();
+        }
+        given[option] = true;
+        char *value = argv[++i];
+        if (option == 0) {
+            parameters->seed = parse_number(value, 0, ULONG_MAX);
+        } else if (option == 1) {
+            parameters->size = parse_number(value, 2, 100000000);
+        } else if (option == 2) {
+            parameters->len = parse_number(value, MIN_WORD_LENGTH,
+                    MAX_WORD_LENGTH);
+        } else if (option == 3) {
+            parameters->density = parse_number(value, 1, 100);
+        } else if (option == 4) {
+            parameters->queries = parse_number(value, 1, 1000000);
+        } else {
+            parameters->dir = value;
+        }
+    }
+}
+
+/*
+next_random():
+--------------
+Advances a xorshift64* generator. The benchmark uses its own generator rather
+than rand() so a seed produces the same dictionary and queries on every
+platform and C library.
+
+arg1: state - The generator state, which must never be zero.
+
+Returns: The next 64-bit pseudo-random number.
+*/
+uint64_t next_random(uint64_t *state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 2685821657736338717ULL;
+}
+
+/*
+random_below():
+---------------
+Returns a pseudo-random number in the range [0, bound).
+
+arg1: state - The generator state.
+arg2: bound - The exclusive upper bound, which must be positive.
+*/
+uint64_t random_below(uint64_t *state, uint64_t bound) {
+    return next_random(state) % bound;
+}
+
+/*
+word_set_find():
+----------------
+Finds a word code in the dictionary's hash set.
+
+arg1: dict - The dictionary to search.
+arg2: code - The word code to look for.
+
+Returns: The index of the word, or -1 if it is not in the dictionary.
+*/
+int word_set_find(Dictionary *dict, uint64_t code) {
+    uint64_t slot = (code * 11400714819323198485ULL >> 17) & dict->slotMask;
+    while (dict->slots[slot] != 0) {
+        if (dict->codes[dict->slots[slot] - 1] == code) {
+            return dict->slots[slot] - 1;
+        }
+        slot = (slot + 1) & dict->slotMask;
+    }
+    return -1;
+}
+
+/*
+word_set_insert():
+------------------
+Adds a word code to the dictionary if it is not already present.
+
+arg1: dict - The dictionary to add to. Its hash set must have room.
+arg2: code - The word code to add.
+
+Returns: true if the word was added, false if it was already present.
+*/
+bool word_set_insert(Dictionary *dict, uint64_t code) {
+    uint64_t slot = (code * 11400714819323198485ULL >> 17) & dict->slotMask;
+    while (dict->slots[slot] != 0) {
+        if (dict->codes[dict->slots[slot] - 1] == code) {
+            return false;
+        }
+        slot = (slot + 1) & dict->slotMask;
+    }
+    dict->codes[dict->numWords] = code;
+    dict->slots[slot] = ++dict->numWords;
+    return true;
+}
+
+/*
+generate_dictionary():
+----------------------
+Generates a seeded synthetic dictionary. The alphabet is the smallest one
+(of at least two letters) whose word space is large enough for the requested
+density, so a higher density means more one-letter neighbours per word. If
+even the full alphabet cannot hold `size` words at this length the size is
+reduced to the number of possible words.
+
+arg1: parameters - The benchmark arguments.
+arg2: dict - The Dictionary struct to fill in.
+arg3: random - The generator state.
+
+Returns: None
+*/
+void generate_dictionary(BenchArgs *parameters, Dictionary *dict,
+        uint64_t *random) {
+    uint64_t space = 0;
+    dict->len = parameters->len;
+    for (dict->alphabet = 2; dict->alphabet <= ALPHABET_SIZE;
+            dict->alphabet++) {
+        space = 1;
+        for (int i = 0; i < dict->len; i++) {
+            space *= dict->alphabet;
+        }
+        if (space * parameters->density / 100 >= (uint64_t)parameters->size) {
+            break;
+        }
+    }
+    if (dict->alphabet > ALPHABET_SIZE) {
+        dict->alphabet = ALPHABET_SIZE;
+    }
+    if (space < (uint64_t)parameters->size) {
+        parameters->size = space;
+    }
+
+    dict->placeValues[0] = 1;
+    for (int i = 1; i < dict->len; i++) {
+        dict->placeValues[i] = dict->placeValues[i - 1] * dict->alphabet;
+    }
+
+    uint64_t capacity = 1;
+    while (capacity < (uint64_t)parameters->size * 2) {
+        capacity *= 2;
+    }
+    dict->slotMask = capacity - 1;
+    dict->slots = calloc(capacity, sizeof(int));
+    dict->codes = malloc(parameters->size * sizeof(uint64_t));
+    dict->numWords = 0;
+    while (dict->numWords < parameters->size) {
+        word_set_insert(dict, random_below(random, space));
+    }
+}
+
+/*
+decode_word():
+--------------
+Converts a word code back into its letters.
+
+arg1: dict - The dictionary the code belongs to.
+arg2: code - The word code.
+arg3: word - Buffer of at least dict->len + 1 characters to write into.
+
+Returns: None
+*/
+void decode_word(Dictionary *dict, uint64_t code, char *word) {
+    for (int i = dict->len - 1; i >= 0; i--) {
+        word[i] = 'a' + code % dict->alphabet;
+        code /= dict->alphabet;
+    }
+    word[dict->len] = '\0';
+}
+
+/*
+write_dictionary():
+-------------------
+Writes the dictionary to a file in the benchmark directory, one word per line,
+creating the directory if needed.
+
+arg1: parameters - The benchmark arguments.
+arg2: dict - The dictionary to write.
+arg3: fileName - Buffer to receive the file name.
+arg4: fileNameSize - Size of the fileName buffer.
+
+Returns: None
+Errors: Exits with status 3 if the directory can't be created, or 11 if the
+        file can't be written.
+*/
+void write_dictionary(BenchArgs *parameters, Dictionary *dict, char *fileName,
+        int fileNameSize) {
+    if (mkdir(parameters->dir, S_IRWXU) == -1 && errno != EEXIST) {
+        fprintf(stderr,
+                "benchuqwordladder: Unable to create directory \"%s\"\n",
+                parameters->dir);
+        exit(BENCH_DIRECTORY_ERROR);
+    }
+    snprintf(fileName, fileNameSize, "%s/bench-%lu-%d-%d-%d.dict",
+            parameters->dir, parameters->seed, parameters->len,
+            parameters->size, parameters->density);
+
+    FILE *file = fopen(fileName, "w");
+    if (file == NULL) {
+        fprintf(stderr,
+                "benchuqwordladder: Can't open file \"%s\" for writing\n",
+                fileName);
+        exit(BENCH_FILE_ERROR);
+    }
+    char word[MAX_WORD_LENGTH + 1];
+    for (int i = 0; i < dict->numWords; i++) {
+        decode_word(dict, dict->codes[i], word);
+        fprintf(file, "%s\n", word);
+    }
+    if (fclose(file) != 0) {
+        fprintf(stderr,
+                "benchuqwordladder: Can't open file \"%s\" for writing\n",
+                fileName);
+        exit(BENCH_FILE_ERROR);
+    }
+}
+
+/*
+breadth_first_search():
+-----------------------
+Computes the ladder distance from one word to every other word. Neighbours
+are found by trying every other letter in every position and looking the
+result up in the hash set.
+
+arg1: dict - The dictionary to search.
+arg2: source - Index of the word to search from.
+arg3: distances - Array of dict->numWords ints to receive the distances;
+      unreachable words get -1.
+arg4: queue - Scratch array of dict->numWords ints.
+
+Returns: The index of a word furthest from the source.
+*/
+int breadth_first_search(Dictionary *dict, int source, int *distances,
+        int *queue) {
+    for (int i = 0; i < dict->numWords; i++) {
+        distances[i] = -1;
+    }
+    int head = 0, tail = 0;
+    distances[source] = 0;
+    queue[tail++] = source;
+    while (head < tail) {
+        int word = queue[head++];
+        uint64_t code = dict->codes[word];
+        for (int pos = 0; pos < dict->len; pos++) {
+            uint64_t place = dict->placeValues[pos];
+            uint64_t digit = code / place % dict->alphabet;
+            uint64_t base = code - digit * place;
+            for (int letter = 0; letter < dict->alphabet; letter++) {
+                int neighbour = word_set_find(dict, base + letter * place);
+                if (letter != (int)digit && neighbour != -1
+                        && distances[neighbour] == -1) {
+                    distances[neighbour] = distances[word] + 1;
+                    queue[tail++] = neighbour;
+                }
+            }
+        }
+    }
+    return queue[tail - 1];
+}
+
+/*
+pick_query_from():
+------------------
+Tries to pick a query of the given class starting from one particular word.
+Reachable and limited queries choose uniformly among the words the start word
+can reach; long queries take the endpoints of a double-sweep BFS; unreachable
+queries look for a word outside the start word's component.
+
+arg1: dict - The dictionary to pick words from.
+arg2: queryClass - The class of query to pick.
+arg3: random - The generator state.
+arg4: distances - Scratch array of dict->numWords ints.
+arg5: queue - Scratch array of dict->numWords ints.
+arg6: query - The Query struct to fill in; its start word must be set.
+
+Returns: true if a query was found from this start word, otherwise false.
+*/
+bool pick_query_from(Dictionary *dict, QueryClass queryClass,
+        uint64_t *random, int *distances, int *queue, Query *query) {
+    int furthest = breadth_first_search(dict, query->start, distances, queue);
+
+    if (queryClass == QUERY_LONG) {
+        query->start = furthest;
+        query->end = breadth_first_search(dict, furthest, distances, queue);
+        return distances[query->end] > 0;
+    }
+
+    if (queryClass == QUERY_UNREACHABLE) {
+        for (int i = 0; i < PICK_ATTEMPTS; i++) {
+            query->end = random_below(random, dict->numWords);
+            if (distances[query->end] == -1) {
+                return true;
+            }
+        }
+        for (query->end = 0; query->end < dict->numWords; query->end++) {
+            if (distances[query->end] == -1) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    int minDistance = queryClass == QUERY_LIMITED ? 2 : 1;
+    int candidates = 0;
+    for (int i = 0; i < dict->numWords; i++) {
+        if (distances[i] >= minDistance) {
+            queue[candidates++] = i;
+        }
+    }
+    if (candidates == 0) {
+        return false;
+    }
+    query->end = queue[random_below(random, candidates)];
+    if (queryClass == QUERY_LIMITED) {
+        query->limit = distances[query->end] - 1;
+    }
+    return true;
+}
+
+/*
+pick_query():
+-------------
+Picks one query of the given class, trying up to PICK_ATTEMPTS random start
+words so that sparse dictionaries with many isolated words still yield
+queries.
+
+arg1: dict - The dictionary to pick words from.
+arg2: queryClass - The class of query to pick.
+arg3: random - The generator state.
+arg4: distances - Scratch array of dict->numWords ints.
+arg5: queue - Scratch array of dict->numWords ints.
+arg6: query - The Query struct to fill in.
+
+Returns: true if a query was found, false if none could be found (for
+         example, no unreachable pairs in a connected graph).
+*/
+bool pick_query(Dictionary *dict, QueryClass queryClass, uint64_t *random,
+        int *distances, int *queue, Query *query) {
+    query->queryClass = queryClass;
+    query->limit = 0;
+    for (int i = 0; i < PICK_ATTEMPTS; i++) {
+        query->start = random_below(random, dict->numWords);
+        if (pick_query_from(dict, queryClass, random, distances, queue,
+                query)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+record_stats():
+---------------
+Parses the "uqwordladder: stats" lines a run wrote to stderr and adds them
+to the totals for the query's class.
+
+arg1: output - The captured stderr of the run, NUL terminated.
+arg2: totals - The totals for the query's class.
+
+Returns: true if all of the program's phases were reported, otherwise false.
+*/
+bool record_stats(char *output, ClassTotals *totals) {
+    int phasesSeen = 0;
+    for (char *line = strtok(output, "\n"); line != NULL;
+            line = strtok(NULL, "\n")) {
+        char phase[16];
+        long long ns;
+        long nodes, maxRss;
+        if (sscanf(line, "uqwordladder: stats %15s ns=%lld nodes=%ld "
+                "maxrss=%ld", phase, &ns, &nodes, &maxRss) != 4) {
+            continue;
+        }
+        for (int i = 0; i < PHASE_PROCESS; i++) {
+            if (strcmp(phase, phaseNames[i]) == 0) {
+                PhaseTotals *phaseTotals = &totals->phases[i];
+                phaseTotals->samples++;
+                phaseTotals->ns += ns;
+                phaseTotals->nodes += nodes;
+                if (maxRss > phaseTotals->peakRss) {
+                    phaseTotals->peakRss = maxRss;
+                }
+                phasesSeen++;
+            }
+        }
+    }
+    return phasesSeen == PHASE_PROCESS;
+}
+
+/*
+run_query():
+------------
+Runs the program once for a query with --stats, capturing its stderr through
+a pipe. stdin and stdout are connected to /dev/null. The whole process is
+timed and its resource usage collected with wait4().
+
+arg1: parameters - The benchmark arguments.
+arg2: dict - The dictionary the query's words belong to.
+arg3: dictFile - The name of the dictionary file.
+arg4: query - The query to run.
+arg5: totals - The totals for the query's class.
+
+Returns: None
+*/
+void run_query(BenchArgs *parameters, Dictionary *dict, char *dictFile,
+        Query *query, ClassTotals *totals) {
+    char start[MAX_WORD_LENGTH + 1], end[MAX_WORD_LENGTH + 1];
+    char len[4], limit[16];
+    decode_word(dict, dict->codes[query->start], start);
+    decode_word(dict, dict->codes[query->end], end);
+    snprintf(len, sizeof(len), "%d", dict->len);
+    snprintf(limit, sizeof(limit), "%d", query->limit);
+    // Without a limit the NULL in place of "--limit" ends the argument list.
+    char *arguments[] = {parameters->program, "--start", start, "--end", end,
+            "--len", len, "--dictionary", dictFile, "--stats",
+            query->limit > 0 ? "--limit" : NULL, limit, NULL};
+
+    int errorPipe[2];
+    pipe(errorPipe);
+    struct timespec started, finished;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    pid_t pid = fork();
+    if (pid == 0) {
+        int devNull = open("/dev/null", O_RDWR);
+        dup2(devNull, STDIN_FILENO);
+        dup2(devNull, STDOUT_FILENO);
+        dup2(errorPipe[1], STDERR_FILENO);
+        close(devNull);
+        close(errorPipe[0]);
+        close(errorPipe[1]);
+        execvp(arguments[0], arguments);
+        _exit(BENCH_EXEC_ERROR);
+    }
+    close(errorPipe[1]);
+
+    size_t size = 0, capacity = 4096;
+    char *output = malloc(capacity);
+    ssize_t got;
+    while ((got = read(errorPipe[0], output + size, capacity - size - 1)) > 0) {
+        size += got;
+        if (capacity - size < 2) {
+            capacity *= 2;
+            output = realloc(output, capacity);
+        }
+    }
+    output[size] = '\0';
+    close(errorPipe[0]);
+
+    int status;
+    struct rusage usage;
+    wait4(pid, &status, 0, &usage);
+    clock_gettime(CLOCK_MONOTONIC, &finished);
+
+    totals->queries++;
+    PhaseTotals *process = &totals->phases[PHASE_PROCESS];
+    process->samples++;
+    process->ns += (finished.tv_sec - started.tv_sec) * 1000000000LL
+            + (finished.tv_nsec - started.tv_nsec);
+    process->nodes += dict->numWords;
+    if (usage.ru_maxrss > process->peakRss) {
+        process->peakRss = usage.ru_maxrss;
+    }
+    if (!record_stats(output, totals) || WIFSIGNALED(status)
+            || (WIFEXITED(status) && WEXITSTATUS(status) == BENCH_EXEC_ERROR)) {
+        totals->failures++;
+    }
+    free(output);
+}
+
+/*
+report_results():
+-----------------
+Prints the results as tab separated values: a header comment recording the
+parameters, a column heading line, then one line per query class and phase
+in a fixed order, so the output of two runs can be compared line by line.
+
+arg1: parameters - The benchmark arguments.
+arg2: dict - The generated dictionary.
+arg3: totals - The totals for each query class.
+
+Returns: None
+*/
+void report_results(BenchArgs *parameters, Dictionary *dict,
+        ClassTotals *totals) {
+    printf("# benchuqwordladder seed=%lu size=%d len=%d density=%d "
+            "alphabet=%d queries=%d\n", parameters->seed, dict->numWords,
+            dict->len, parameters->density, dict->alphabet,
+            parameters->queries);
+    printf("class\tphase\tqueries\tfailures\tns_per_query\tnodes_per_sec\t"
+            "peak_rss_kb\n");
+    for (int c = 0; c < NUM_QUERY_CLASSES; c++) {
+        for (int p = 0; p < NUM_PHASES; p++) {
+            PhaseTotals *phase = &totals[c].phases[p];
+            long long nsPerQuery = phase->samples ? phase->ns / phase->samples
+                    : 0;
+            long long nodesPerSec = phase->ns ? (long long)(phase->nodes
+                    * 1e9 / phase->ns) : 0;
+            printf("%s\t%s\t%d\t%d\t%lld\t%lld\t%ld\n", queryClassNames[c],
+                    phaseNames[p], totals[c].queries, totals[c].failures,
+                    nsPerQuery, nodesPerSec, phase->peakRss);
+        }
+    }
+    fflush(stdout);
+}
+
+int main(int argc, char *argv[]) {
+    BenchArgs parameters;
+    command_line_arguments(argc, argv, &parameters);
+
+    uint64_t random = parameters.seed * 2 + 1;
+    Dictionary dict;
+    generate_dictionary(&parameters, &dict, &random);
+    char dictFile[PATH_MAX];
+    write_dictionary(&parameters, &dict, dictFile, sizeof(dictFile));
+
+    // Pick the whole query mix before running anything, so the queries depend
+    // only on the seed and not on how the runs interleave.
+    int *distances = malloc(dict.numWords * sizeof(int));
+    int *queue = malloc(dict.numWords * sizeof(int));
+    Query *queries = malloc(NUM_QUERY_CLASSES * parameters.queries
+            * sizeof(Query));
+    int numQueries = 0;
+    for (int c = 0; c < NUM_QUERY_CLASSES; c++) {
+        for (int i = 0; i < parameters.queries; i++) {
+            if (pick_query(&dict, c, &random, distances, queue,
+                    &queries[numQueries])) {
+                numQueries++;
+            }
+        }
+    }
+
+    ClassTotals totals[NUM_QUERY_CLASSES];
+    memset(totals, 0, sizeof(totals));
+    for (int i = 0; i < numQueries; i++) {
+        run_query(&parameters, &dict, dictFile, &queries[i],
+                &totals[queries[i].queryClass]);
+    }
+    report_results(&parameters, &dict, totals);
+
+    free(queries);
+    free(queue);
+    free(distances);
+    free(dict.codes);
+    free(dict.slots);
+    return 0;
+}
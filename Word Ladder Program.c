@@ -11,6 +11,12 @@
 #include <stdbool.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <pthread.h>
 #include <csse2310a1.h>
 
 #define INVALID_COMMAND_LINE_ARGUMENT_4 \
@@ -32,16 +38,118 @@
 #define EXIT_GIVE_UP 8 
 #define EXIT_ATTEMPTS_OVER 8 
 
+#define DELTA_LINE_INVALID \
+    "uqwordladder: Invalid line %d in delta file \"%s\"\n"
+#define DICTIONARY_WRITE_FAILED \
+    "uqwordladder: Unable to write dictionary \"%s\"\n"
+#define INDEX_FILE_SUFFIX ".index"
+#define INDEX_FILE_MAGIC 0x31584449574c5155ULL
+#define PHASE_STATS "uqwordladder: stats %s ns=%lld nodes=%ld maxrss=%ld\n"
+#define BLOOM_STATS "uqwordladder: stats bloom lookups=%ld rejected=%ld " \
+    "falsepositives=%ld fpr=%.6f\n"
+
+#define GENERATE_NEEDS_STEPS "uqwordladder: --generate needs --steps"
+#define ANALYSIS_HUB_WORDS 10
+
+#define BLOOM_BITS_PER_WORD 10
+#define BLOOM_HASHES 7
+#define BLOOM_BLOCK_WORDS 8
+#define BLOOM_BLOCK_BITS (BLOOM_BLOCK_WORDS * 64)
+
+// Open-addressing hash index over dictionaryElement. Each slot holds the
+// line number of a word plus one, so 0 marks an empty slot.
+typedef struct {
+    int *slots;
+    int capacity;
+    int count;
+    long probes;
+} wordIndex;
+
+// Header of the index file saved next to the dictionary, followed by the
+// slots. The dictionary's size, inode and modification time tie the index to
+// the exact file it was built from; any other file gets a fresh index.
+typedef struct {
+    uint64_t magic;
+    uint64_t dictionarySize;
+    uint64_t dictionaryInode;
+    int64_t dictionaryModifiedSec;
+    int64_t dictionaryModifiedNsec;
+    int32_t lines;
+    int32_t capacity;
+    int32_t count;
+    int32_t reserved;
+} indexFileHeader;
+
+// Blocked Bloom filter over the dictionary. All of a word's bits fall in one
+// 64-byte block, so a lookup touches a single cache line. The counters record
+// how often the filter was consulted and how often it let through a word the
+// index then failed to find.
+typedef struct {
+    uint64_t *blocks;
+    uint64_t numBlocks;
+    long lookups;
+    long rejected;
+    long falsePositives;
+} bloomFilter;
+
+// Word graph in compressed sparse row form: the neighbours of word i are
+// neighbours[offsets[i]] to neighbours[offsets[i + 1] - 1]. Words are also
+// labelled with their connected component.
+typedef struct {
+    int *offsets;
+    int *neighbours;
+    int *component;
+    int *componentSize;
+    int numComponents;
+} wordGraph;
+
 typedef struct {
     char *startWord;
     char *destWord;
     char *dictionary;
+    char *delta;
     char **dictionaryElement; 
     int dictionaryLines;
+    wordIndex index;
+    bloomFilter bloom;
+    wordGraph graph;
     int len;
     int limit;
+    bool stats;
+    int generate;
+    int steps;
+    bool unique;
+    int threads;
+    unsigned long seed;
+    char *analyse;
 } cmdArgs;
 
+// Shared state for the puzzle generator threads. Sources are handed out in
+// a seeded shuffled order and each one's result is stored by position, so the
+// puzzles printed do not depend on how the threads interleave.
+typedef struct {
+    cmdArgs *arguments;
+    int *sources;
+    int *results;
+    int nextSource;
+    int found;
+    pthread_mutex_t lock;
+} puzzleGenerator;
+
+// Shared state for the graph analysis threads, which each take the next
+// largest component and estimate its diameter with a double-sweep BFS.
+typedef struct {
+    cmdArgs *arguments;
+    int *order;
+    int *root;
+    int nextComponent;
+    int diameter;
+    int diameterFrom;
+    int diameterTo;
+    int diameterPosition;
+    pthread_mutex_t lock;
+} graphAnalysis;
+
 void valid_integer(char *str)
 {
     float digit;
@@ -71,14 +179,30 @@ void command_line_arguments(int argc, char *argv[], cmdArgs *arguments) {
     arguments->startWord = NULL;
     arguments->destWord = NULL;
     arguments->dictionary = NULL;
+    arguments->delta = NULL;
+    arguments->dictionaryElement = NULL;
+    arguments->dictionaryLines = 0;
     arguments->len = -1;
     arguments->limit = -1;
+    arguments->stats = false;
+    arguments->generate = 0;
+    arguments->steps = -1;
+    arguments->unique = false;
+    arguments->threads = sysconf(_SC_NPROCESSORS_ONLN);
+    arguments->seed = 1;
+    arguments->analyse = NULL;
 
     bool startWordSupplied = false;
     bool destWordSupplied = false;
     bool lenSupplied = false;
     bool limitSupplied = false;
     bool dictSupplied = false;
+    bool deltaSupplied = false;
+    bool generateSupplied = false;
+    bool stepsSupplied = false;
+    bool threadsSupplied = false;
+    bool seedSupplied = false;
+    bool uniqueSupplied = false;
 
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "--start") == 0) {
@@ -128,6 +252,60 @@ void command_line_arguments(int argc, char *argv[], cmdArgs *arguments) {
             }
             dictSupplied = true;
 
+        } else if (strcmp(argv[i], "--delta") == 0) {
+            if (!deltaSupplied && ++i < argc) {
+                arguments->delta = argv[i];
+            } else {
+                fprintf(stderr, "%s\n", INVALID_COMMAND_LINE_ARGUMENT_4);
+                exit(EXIT_STATUS_4);
+            }
+            deltaSupplied = true;
+
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            arguments->stats = true;
+
+        } else if (strcmp(argv[i], "--generate") == 0
+                || strcmp(argv[i], "--steps") == 0
+                || strcmp(argv[i], "--threads") == 0
+                || strcmp(argv[i], "--seed") == 0) {
+            bool *supplied = strcmp(argv[i], "--generate") == 0
+                    ? &generateSupplied : strcmp(argv[i], "--steps") == 0
+                    ? &stepsSupplied : strcmp(argv[i], "--threads") == 0
+                    ? &threadsSupplied : &seedSupplied;
+            if (*supplied || i + 1 >= argc) {
+                fprintf(stderr, "%s\n", INVALID_COMMAND_LINE_ARGUMENT_4);
+                exit(EXIT_STATUS_4);
+            }
+            *supplied = true;
+            valid_integer(argv[i + 1]);
+            if (strcmp(argv[i], "--generate") == 0) {
+                arguments->generate = atoi(argv[++i]);
+            } else if (strcmp(argv[i], "--steps") == 0) {
+                arguments->steps = atoi(argv[++i]);
+            } else if (strcmp(argv[i], "--threads") == 0) {
+                arguments->threads = atoi(argv[++i]);
+            } else {
+                arguments->seed = strtoul(argv[++i], NULL, 10);
+            }
+
+        } else if (strcmp(argv[i], "--analyse") == 0) {
+            if (arguments->analyse == NULL && ++i < argc
+                    && (strcmp(argv[i], "csv") == 0
+                    || strcmp(argv[i], "json") == 0)) {
+                arguments->analyse = argv[i];
+            } else {
+                fprintf(stderr, "%s\n", INVALID_COMMAND_LINE_ARGUMENT_4);
+                exit(EXIT_STATUS_4);
+            }
+
+        } else if (strcmp(argv[i], "--unique") == 0) {
+            if (uniqueSupplied) {
+                fprintf(stderr, "%s\n", INVALID_COMMAND_LINE_ARGUMENT_4);
+                exit(EXIT_STATUS_4);
+            }
+            arguments->unique = true;
+            uniqueSupplied = true;
+
         } else {
             fprintf(stderr, "%s\n", INVALID_COMMAND_LINE_ARGUMENT_4);
             exit(EXIT_STATUS_4);
@@ -163,7 +341,7 @@ void string_string_comparison(char *string1, char *string2) {
     }
 }
 
-void open_file(char *filename, char **file_pointer, int *numLines) {
+void open_file(char *filename, char ***file_pointer, int *numLines) {
     FILE *file;
     file = fopen(filename, "r");
     if (file == NULL) {
@@ -175,6 +353,9 @@ void open_file(char *filename, char **file_pointer, int *numLines) {
     ssize_t read;
     *numLines = 0;
     while ((read = getline(&line, &len, file)) != -1) {
+        if (read > 0 && line[read - 1] == '\n') {
+            line[read - 1] = '\0';
+        }
         *file_pointer = realloc(*file_pointer, (*numLines + 1) * sizeof(char *));
         (*file_pointer)[*numLines] = strdup(line);
         (*numLines)++;
@@ -183,32 +364,405 @@ void open_file(char *filename, char **file_pointer, int *numLines) {
     fclose(file);
 }
 
-void line_start_end(char *line, char **start, char **end) {
-    char *token;
-    token = strtok(line, " \n");
-    *start = strdup(token);
-    token = strtok(NULL, " \n");
-    *end = strdup(token);
+// Length of the word at the start of a dictionary line, ignoring anything
+// from the first space or newline onwards.
+int word_length(const char *line) {
+    return strcspn(line, " \n");
+}
+
+unsigned int hash_word(const char *word, int length) {
+    unsigned int hash = 2166136261u;
+    for (int i = 0; i < length; i++) {
+        hash = (hash ^ (unsigned char)word[i]) * 16777619u;
+    }
+    return hash;
+}
+
+void index_grow(wordIndex *index, char **words);
+
+// Returns the slot holding word, or the empty slot where it would go.
+int index_slot(wordIndex *index, char **words, const char *word, int length) {
+    int mask = index->capacity - 1;
+    int slot = hash_word(word, length) & mask;
+    while (index->slots[slot] != 0) {
+        index->probes++;
+        char *candidate = words[index->slots[slot] - 1];
+        if (word_length(candidate) == length
+                && strncmp(candidate, word, length) == 0) {
+            return slot;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+// Returns the dictionary line holding word, or -1 if it is not present.
+int index_find(wordIndex *index, char **words, const char *word, int length) {
+    int slot = index_slot(index, words, word, length);
+    return index->slots[slot] - 1;
+}
+
+void index_insert(wordIndex *index, char **words, int line) {
+    if ((index->count + 1) * 2 > index->capacity) {
+        index_grow(index, words);
+    }
+    int slot = index_slot(index, words, words[line], word_length(words[line]));
+    if (index->slots[slot] == 0) {
+        index->count++;
+    }
+    index->slots[slot] = line + 1;
 }
 
-void start_end_check(cmdArgs *arguments, int numLines, char **file_pointer) {
-    bool startFound = false;
-    bool endFound = false;
+// Removes the entry in slot, shifting later entries of the same probe run
+// back so lookups never need tombstones.
+void index_remove_slot(wordIndex *index, char **words, int slot) {
+    int mask = index->capacity - 1;
+    int hole = slot;
+    index->slots[hole] = 0;
+    index->count--;
+    for (int next = (hole + 1) & mask; index->slots[next] != 0;
+            next = (next + 1) & mask) {
+        char *word = words[index->slots[next] - 1];
+        int home = hash_word(word, word_length(word)) & mask;
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            index->slots[hole] = index->slots[next];
+            index->slots[next] = 0;
+            hole = next;
+        }
+    }
+}
 
-    for (int i = 0; i < numLines; i++) {
-        char *line = strdup(file_pointer[i]);
-        char *start;
-        char *end;
-        line_start_end(line, &start, &end);
-        if (strcmp(start, arguments->startWord) == 0) {
-            startFound = true;
-        } else if (strcmp(start, arguments->destWord) == 0) {
-            endFound = true;
+void index_grow(wordIndex *index, char **words) {
+    int *oldSlots = index->slots;
+    int oldCapacity = index->capacity;
+    index->capacity = oldCapacity ? oldCapacity * 2 : 64;
+    index->slots = calloc(index->capacity, sizeof(int));
+    index->count = 0;
+    for (int i = 0; i < oldCapacity; i++) {
+        if (oldSlots[i] != 0) {
+            index_insert(index, words, oldSlots[i] - 1);
         }
-        free(line);
-        free(start);
-        free(end);
     }
+    free(oldSlots);
+}
+
+// Returns the name of the index file saved next to the dictionary. The caller
+// frees it.
+char *index_file_name(const char *dictionary, const char *suffix) {
+    int nameLength = strlen(dictionary) + strlen(INDEX_FILE_SUFFIX)
+            + strlen(suffix) + 1;
+    char *name = malloc(nameLength);
+    snprintf(name, nameLength, "%s%s%s", dictionary, INDEX_FILE_SUFFIX, suffix);
+    return name;
+}
+
+void index_file_header(indexFileHeader *header, struct stat *dictionary,
+        cmdArgs *arguments) {
+    memset(header, 0, sizeof(*header));
+    header->magic = INDEX_FILE_MAGIC;
+    header->dictionarySize = dictionary->st_size;
+    header->dictionaryInode = dictionary->st_ino;
+    header->dictionaryModifiedSec = dictionary->st_mtim.tv_sec;
+    header->dictionaryModifiedNsec = dictionary->st_mtim.tv_nsec;
+    header->lines = arguments->dictionaryLines;
+    header->capacity = arguments->index.capacity;
+    header->count = arguments->index.count;
+}
+
+// Loads the index saved by the last --delta run if it was built from the
+// dictionary as it is now. Returns false, leaving the index empty, if there
+// is no such index or it does not check out.
+bool load_word_index(cmdArgs *arguments) {
+    wordIndex *index = &arguments->index;
+    struct stat dictionary;
+    indexFileHeader header, expected;
+    if (stat(arguments->dictionary, &dictionary) != 0) {
+        return false;
+    }
+    char *name = index_file_name(arguments->dictionary, "");
+    FILE *file = fopen(name, "r");
+    free(name);
+    if (file == NULL) {
+        return false;
+    }
+    bool loaded = fread(&header, sizeof(header), 1, file) == 1;
+    index_file_header(&expected, &dictionary, arguments);
+    expected.capacity = header.capacity;
+    expected.count = header.count;
+    loaded = loaded && memcmp(&header, &expected, sizeof(header)) == 0
+            && header.capacity >= 64
+            && (header.capacity & (header.capacity - 1)) == 0
+            && header.count * 2 <= header.capacity;
+    if (loaded) {
+        index->slots = malloc(header.capacity * sizeof(int));
+        index->capacity = header.capacity;
+        index->count = header.count;
+        loaded = fread(index->slots, sizeof(int), header.capacity, file)
+                == (size_t)header.capacity;
+        for (int i = 0; loaded && i < header.capacity; i++) {
+            loaded = index->slots[i] >= 0
+                    && index->slots[i] <= arguments->dictionaryLines;
+        }
+        if (!loaded) {
+            free(index->slots);
+            index->slots = NULL;
+            index->capacity = 0;
+            index->count = 0;
+        }
+    }
+    fclose(file);
+    return loaded;
+}
+
+// Writes the index to a temporary file for the dictionary file described by
+// dictionary. Returns the temporary file's name, or NULL if it could not be
+// written.
+char *write_word_index(cmdArgs *arguments, struct stat *dictionary) {
+    indexFileHeader header;
+    index_file_header(&header, dictionary, arguments);
+    char *tempName = index_file_name(arguments->dictionary, ".tmp");
+    FILE *file = fopen(tempName, "w");
+    if (file == NULL) {
+        free(tempName);
+        return NULL;
+    }
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1
+            && fwrite(arguments->index.slots, sizeof(int),
+            arguments->index.capacity, file)
+            == (size_t)arguments->index.capacity;
+    if (fclose(file) != 0 || !written) {
+        unlink(tempName);
+        free(tempName);
+        return NULL;
+    }
+    return tempName;
+}
+
+void build_word_index(cmdArgs *arguments) {
+    arguments->index.slots = NULL;
+    arguments->index.capacity = 0;
+    arguments->index.count = 0;
+    arguments->index.probes = 0;
+    if (load_word_index(arguments)) {
+        return;
+    }
+    index_grow(&arguments->index, arguments->dictionaryElement);
+    for (int i = 0; i < arguments->dictionaryLines; i++) {
+        index_insert(&arguments->index, arguments->dictionaryElement, i);
+    }
+}
+
+// FNV-1a of the word passed through a 64-bit finalizer. FNV alone leaves
+// short words clustered in its low bits, so every bit of the result is mixed
+// from every input byte before it is split up.
+uint64_t bloom_hash(const char *word, int length) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (int i = 0; i < length; i++) {
+        hash = (hash ^ (unsigned char)word[i]) * 1099511628211ULL;
+    }
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    return hash ^ (hash >> 33);
+}
+
+// Returns the block holding a word's bits and fills bits with the
+// BLOOM_HASHES bit positions inside it. The block comes from the high 32 bits
+// of the hash and the positions from the low 32 bits by double hashing, so
+// the two choices are independent.
+uint64_t *bloom_bits(bloomFilter *bloom, const char *word, int length,
+        uint32_t *bits) {
+    uint64_t hash = bloom_hash(word, length);
+    uint32_t start = (uint32_t)hash & 0xffff;
+    uint32_t step = ((uint32_t)hash >> 16) | 1;
+    for (int i = 0; i < BLOOM_HASHES; i++) {
+        bits[i] = (start + i * step) % BLOOM_BLOCK_BITS;
+    }
+    return bloom->blocks + (hash >> 32) % bloom->numBlocks * BLOOM_BLOCK_WORDS;
+}
+
+void build_bloom_filter(cmdArgs *arguments) {
+    bloomFilter *bloom = &arguments->bloom;
+    uint64_t totalBits =
+            (uint64_t)arguments->dictionaryLines * BLOOM_BITS_PER_WORD;
+    size_t size;
+    bloom->numBlocks = totalBits / BLOOM_BLOCK_BITS + 1;
+    size = bloom->numBlocks * BLOOM_BLOCK_WORDS * sizeof(uint64_t);
+    if (posix_memalign((void **)&bloom->blocks, 64, size) != 0) {
+        bloom->blocks = malloc(size);
+    }
+    memset(bloom->blocks, 0, size);
+    bloom->lookups = 0;
+    bloom->rejected = 0;
+    bloom->falsePositives = 0;
+    uint32_t bits[BLOOM_HASHES];
+    for (int i = 0; i < arguments->dictionaryLines; i++) {
+        char *word = arguments->dictionaryElement[i];
+        uint64_t *block = bloom_bits(bloom, word, word_length(word), bits);
+        for (int j = 0; j < BLOOM_HASHES; j++) {
+            block[bits[j] / 64] |= 1ULL << (bits[j] % 64);
+        }
+    }
+}
+
+bool bloom_may_contain(bloomFilter *bloom, const char *word, int length) {
+    uint32_t bits[BLOOM_HASHES];
+    uint64_t *block = bloom_bits(bloom, word, length, bits);
+    for (int i = 0; i < BLOOM_HASHES; i++) {
+        if (!(block[bits[i] / 64] & (1ULL << (bits[i] % 64)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Dictionary lookup returning the line holding word, or -1. The Bloom filter
+// rejects most absent words before the hash index is probed.
+int dictionary_find(cmdArgs *arguments, const char *word, int length) {
+    bloomFilter *bloom = &arguments->bloom;
+    bloom->lookups++;
+    if (!bloom_may_contain(bloom, word, length)) {
+        bloom->rejected++;
+        return -1;
+    }
+    int line = index_find(&arguments->index, arguments->dictionaryElement,
+            word, length);
+    if (line == -1) {
+        bloom->falsePositives++;
+    }
+    return line;
+}
+
+bool dictionary_contains(cmdArgs *arguments, const char *word, int length) {
+    return dictionary_find(arguments, word, length) != -1;
+}
+
+// Checks a word from a delta file is letters only and of the dictionary's
+// word length.
+bool delta_word_valid(const char *word, int length, int wordLength) {
+    if (length != wordLength) {
+        return false;
+    }
+    for (int i = 0; i < length; i++) {
+        if (!isalpha((unsigned char)word[i])) {
+            return false;
+        }
+    }
+    return word[length] == '\n' || word[length] == '\0';
+}
+
+// Applies a delta file to the loaded dictionary. Each non-empty line is
+// "+word" to add a word or "-word" to remove one; adding a word that is
+// already present or removing one that is absent is a no-op. Removed lines
+// are compacted out at the end so the order of the remaining words is kept.
+// An invalid line stops the program before anything is saved.
+void apply_delta_file(cmdArgs *arguments) {
+    FILE *file = fopen(arguments->delta, "r");
+    if (file == NULL) {
+        fprintf(stderr, "%s: File not found\n", arguments->delta);
+        exit(EXIT_STATUS_4);
+    }
+    char **words = arguments->dictionaryElement;
+    wordIndex *index = &arguments->index;
+    char *line = NULL;
+    size_t len = 0;
+    int lineNum = 0;
+    bool removed = false;
+    while (getline(&line, &len, file) != -1) {
+        lineNum++;
+        char *word = line + 1;
+        int length = word_length(word);
+        if (line[0] == '\n') {
+            continue;
+        }
+        if ((line[0] != '+' && line[0] != '-')
+                || !delta_word_valid(word, length, arguments->len)) {
+            fprintf(stderr, DELTA_LINE_INVALID, lineNum, arguments->delta);
+            exit(EXIT_STATUS_4);
+        }
+        int slot = index_slot(index, words, word, length);
+        if (line[0] == '-' && index->slots[slot] != 0) {
+            int found = index->slots[slot] - 1;
+            index_remove_slot(index, words, slot);
+            free(words[found]);
+            words[found] = NULL;
+            removed = true;
+        } else if (line[0] == '+' && index->slots[slot] == 0) {
+            words = realloc(words,
+                    (arguments->dictionaryLines + 1) * sizeof(char *));
+            words[arguments->dictionaryLines] = strndup(word, length);
+            index_insert(index, words, arguments->dictionaryLines++);
+        }
+    }
+    free(line);
+    fclose(file);
+
+    if (removed) {
+        int kept = 0;
+        for (int i = 0; i < arguments->dictionaryLines; i++) {
+            if (words[i] == NULL) {
+                continue;
+            }
+            if (kept != i) {
+                words[kept] = words[i];
+                int slot = index_slot(index, words, words[kept],
+                        word_length(words[kept]));
+                index->slots[slot] = kept + 1;
+            }
+            kept++;
+        }
+        arguments->dictionaryLines = kept;
+    }
+    arguments->dictionaryElement = words;
+}
+
+// Writes the dictionary and its index back out through temporary files that
+// are renamed over the originals, so an interrupted update never leaves a
+// partial file. The index is renamed first; if the dictionary rename then
+// fails, the index no longer matches it and the next run rebuilds it.
+void save_dictionary(cmdArgs *arguments) {
+    int nameLength = strlen(arguments->dictionary) + 5;
+    char tempName[nameLength];
+    snprintf(tempName, nameLength, "%s.tmp", arguments->dictionary);
+    FILE *file = fopen(tempName, "w");
+    if (file == NULL) {
+        fprintf(stderr, DICTIONARY_WRITE_FAILED, arguments->dictionary);
+        exit(EXIT_STATUS_4);
+    }
+    for (int i = 0; i < arguments->dictionaryLines; i++) {
+        fprintf(file, "%s\n", arguments->dictionaryElement[i]);
+    }
+    struct stat dictionary;
+    char *indexTempName = NULL;
+    if (fclose(file) != 0 || stat(tempName, &dictionary) != 0) {
+        unlink(tempName);
+        fprintf(stderr, DICTIONARY_WRITE_FAILED, arguments->dictionary);
+        exit(EXIT_STATUS_4);
+    }
+
+    // The index is only a cache, so failing to save it is not an error.
+    indexTempName = write_word_index(arguments, &dictionary);
+    if (indexTempName != NULL) {
+        char *indexName = index_file_name(arguments->dictionary, "");
+        if (rename(indexTempName, indexName) != 0) {
+            unlink(indexTempName);
+        }
+        free(indexName);
+        free(indexTempName);
+    }
+    if (rename(tempName, arguments->dictionary) != 0) {
+        unlink(tempName);
+        fprintf(stderr, DICTIONARY_WRITE_FAILED, arguments->dictionary);
+        exit(EXIT_STATUS_4);
+    }
+}
+
+void start_end_check(cmdArgs *arguments) {
+    bool startFound = dictionary_contains(arguments, arguments->startWord,
+            strlen(arguments->startWord));
+    bool endFound = dictionary_contains(arguments, arguments->destWord,
+            strlen(arguments->destWord));
 
     if (!startFound) {
         fprintf(stderr, "uqwordladder: Start word '%s' not in dictionary\n", arguments->startWord);
@@ -221,27 +775,590 @@ void start_end_check(cmdArgs *arguments, int numLines, char **file_pointer) {
     }
 }
 
+// With --stats, reports how long the phase that began at phaseStart took,
+// how many dictionary nodes it touched and the peak RSS so far, then starts
+// timing the next phase.
+void report_phase(cmdArgs *arguments, const char *phase,
+        struct timespec *phaseStart, long nodes) {
+    if (!arguments->stats) {
+        return;
+    }
+    struct timespec now;
+    struct rusage usage;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    getrusage(RUSAGE_SELF, &usage);
+    long long ns = (now.tv_sec - phaseStart->tv_sec) * 1000000000LL
+            + (now.tv_nsec - phaseStart->tv_nsec);
+    fprintf(stderr, PHASE_STATS, phase, ns, nodes, usage.ru_maxrss);
+    *phaseStart = now;
+}
+
+// With --stats, reports the Bloom filter's measured false-positive rate: the
+// fraction of absent words that got past the filter to the hash index.
+void report_bloom(cmdArgs *arguments) {
+    if (!arguments->stats) {
+        return;
+    }
+    bloomFilter *bloom = &arguments->bloom;
+    long absent = bloom->rejected + bloom->falsePositives;
+    fprintf(stderr, BLOOM_STATS, bloom->lookups, bloom->rejected,
+            bloom->falsePositives,
+            absent ? (double)bloom->falsePositives / absent : 0.0);
+}
+
+// Builds the word graph by trying every other letter in every position of
+// each word. Most candidates are not words, so the Bloom filter in
+// dictionary_find() turns them away without touching the hash index.
+void build_word_graph(cmdArgs *arguments) {
+    wordGraph *graph = &arguments->graph;
+    int numWords = arguments->dictionaryLines;
+    int capacity = numWords + 1;
+    graph->offsets = malloc((numWords + 1) * sizeof(int));
+    graph->neighbours = malloc(capacity * sizeof(int));
+    graph->offsets[0] = 0;
+    char candidate[MAX__WORD_LENGTH + 1];
+    for (int i = 0; i < numWords; i++) {
+        int count = graph->offsets[i];
+        int length = word_length(arguments->dictionaryElement[i]);
+        memcpy(candidate, arguments->dictionaryElement[i], length);
+        for (int pos = 0; pos < length; pos++) {
+            char original = candidate[pos];
+            for (char letter = 'a'; letter <= 'z'; letter++) {
+                if (letter == original) {
+                    continue;
+                }
+                candidate[pos] = letter;
+                int neighbour = dictionary_find(arguments, candidate, length);
+                if (neighbour == -1) {
+                    continue;
+                }
+                if (count == capacity) {
+                    capacity *= 2;
+                    graph->neighbours = realloc(graph->neighbours,
+                            capacity * sizeof(int));
+                }
+                graph->neighbours[count++] = neighbour;
+            }
+            candidate[pos] = original;
+        }
+        graph->offsets[i + 1] = count;
+    }
+}
+
+// Labels every word with its connected component and records the size of
+// each component.
+void label_components(cmdArgs *arguments) {
+    wordGraph *graph = &arguments->graph;
+    int numWords = arguments->dictionaryLines;
+    int *queue = malloc(numWords * sizeof(int));
+    graph->component = malloc(numWords * sizeof(int));
+    graph->componentSize = malloc(numWords * sizeof(int));
+    graph->numComponents = 0;
+    for (int i = 0; i < numWords; i++) {
+        graph->component[i] = -1;
+    }
+    for (int i = 0; i < numWords; i++) {
+        if (graph->component[i] != -1) {
+            continue;
+        }
+        int label = graph->numComponents++;
+        int head = 0, tail = 0;
+        graph->component[i] = label;
+        queue[tail++] = i;
+        while (head < tail) {
+            int word = queue[head++];
+            for (int j = graph->offsets[word]; j < graph->offsets[word + 1];
+                    j++) {
+                int neighbour = graph->neighbours[j];
+                if (graph->component[neighbour] == -1) {
+                    graph->component[neighbour] = label;
+                    queue[tail++] = neighbour;
+                }
+            }
+        }
+        graph->componentSize[label] = tail;
+    }
+    free(queue);
+}
+
+uint64_t next_random(uint64_t *state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 2685821657736338717ULL;
+}
+
+// Breadth-first search from source that stops at depth steps, counting
+// shortest paths (saturating at 2) as it goes. Words are only valid for this
+// search when their stamp matches, which avoids clearing the arrays between
+// searches. Returns the end word of a puzzle from source, or -1 if there is
+// none.
+int find_puzzle_end(cmdArgs *arguments, int source, int *queue, int *stamp,
+        int currentStamp, int *distance, unsigned char *paths) {
+    wordGraph *graph = &arguments->graph;
+    int head = 0, tail = 0;
+    stamp[source] = currentStamp;
+    distance[source] = 0;
+    paths[source] = 1;
+    queue[tail++] = source;
+    while (head < tail) {
+        int word = queue[head++];
+        if (distance[word] == arguments->steps) {
+            continue;
+        }
+        for (int j = graph->offsets[word]; j < graph->offsets[word + 1]; j++) {
+            int neighbour = graph->neighbours[j];
+            if (stamp[neighbour] != currentStamp) {
+                stamp[neighbour] = currentStamp;
+                distance[neighbour] = distance[word] + 1;
+                paths[neighbour] = paths[word];
+                queue[tail++] = neighbour;
+            } else if (distance[neighbour] == distance[word] + 1) {
+                paths[neighbour] = paths[neighbour] + paths[word] > 1 ? 2 : 1;
+            }
+        }
+    }
+
+    // Words at the full distance are at the end of the queue. Move the ones
+    // that qualify to the front, reading ahead of where they are written,
+    // and pick one of them at random for this source.
+    int first = tail;
+    while (first > 0 && distance[queue[first - 1]] == arguments->steps) {
+        first--;
+    }
+    int candidates = 0;
+    for (int i = first; i < tail; i++) {
+        if (!arguments->unique || paths[queue[i]] == 1) {
+            queue[candidates++] = queue[i];
+        }
+    }
+    if (candidates == 0) {
+        return -1;
+    }
+    uint64_t random = (arguments->seed + 1) * 0x9e3779b97f4a7c15ULL
+            ^ (uint64_t)(source + 1);
+    return queue[next_random(&random) % candidates];
+}
+
+void *puzzle_worker(void *data) {
+    puzzleGenerator *generator = data;
+    cmdArgs *arguments = generator->arguments;
+    int numWords = arguments->dictionaryLines;
+    int *queue = malloc(numWords * sizeof(int));
+    int *stamp = calloc(numWords, sizeof(int));
+    int *distance = malloc(numWords * sizeof(int));
+    unsigned char *paths = malloc(numWords);
+    int currentStamp = 0;
+
+    while (true) {
+        pthread_mutex_lock(&generator->lock);
+        int position = generator->nextSource;
+        bool done = position == numWords
+                || generator->found >= arguments->generate;
+        if (!done) {
+            generator->nextSource++;
+        }
+        pthread_mutex_unlock(&generator->lock);
+        if (done) {
+            break;
+        }
+
+        // A component needs more than steps words to hold a puzzle.
+        int source = generator->sources[position];
+        int component = arguments->graph.component[source];
+        int end = -1;
+        if (arguments->graph.componentSize[component] > arguments->steps) {
+            end = find_puzzle_end(arguments, source, queue, stamp,
+                    ++currentStamp, distance, paths);
+        }
+        generator->results[position] = end;
+        if (end != -1) {
+            pthread_mutex_lock(&generator->lock);
+            generator->found++;
+            pthread_mutex_unlock(&generator->lock);
+        }
+    }
+    free(queue);
+    free(stamp);
+    free(distance);
+    free(paths);
+    return NULL;
+}
+
+// Runs worker on data in up to --threads threads, capped at the number of
+// online CPUs, and waits for them all. The workers share their work through
+// data, so if no thread can be created the calling thread does it all.
+void run_worker_threads(cmdArgs *arguments, void *(*worker)(void *),
+        void *data) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int numThreads = arguments->threads;
+    if (cpus > 0 && numThreads > cpus) {
+        numThreads = cpus;
+    }
+    if (numThreads < 1) {
+        numThreads = 1;
+    }
+    pthread_t *threads = malloc(numThreads * sizeof(pthread_t));
+    int started = 0;
+    while (started < numThreads
+            && pthread_create(&threads[started], NULL, worker, data) == 0) {
+        started++;
+    }
+    if (started == 0) {
+        worker(data);
+    }
+    for (int i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+}
+
+// Prints up to --generate start/end pairs whose shortest ladder is exactly
+// --steps steps (and, with --unique, has only one shortest ladder). Each start
+// word gives at most one puzzle so the puzzles are spread over the dictionary.
+void generate_puzzles(cmdArgs *arguments) {
+    int numWords = arguments->dictionaryLines;
+    puzzleGenerator generator;
+    generator.arguments = arguments;
+    generator.sources = malloc(numWords * sizeof(int));
+    generator.results = malloc(numWords * sizeof(int));
+    generator.nextSource = 0;
+    generator.found = 0;
+    pthread_mutex_init(&generator.lock, NULL);
+
+    uint64_t random = arguments->seed * 2 + 1;
+    for (int i = 0; i < numWords; i++) {
+        generator.sources[i] = i;
+    }
+    for (int i = numWords - 1; i > 0; i--) {
+        int j = next_random(&random) % (i + 1);
+        int swap = generator.sources[i];
+        generator.sources[i] = generator.sources[j];
+        generator.sources[j] = swap;
+    }
+
+    run_worker_threads(arguments, puzzle_worker, &generator);
+
+    // Every source before nextSource has been searched, so the first
+    // puzzles in source order are the same whatever the thread count.
+    int printed = 0;
+    char **words = arguments->dictionaryElement;
+    for (int i = 0; i < generator.nextSource && printed < arguments->generate;
+            i++) {
+        int end = generator.results[i];
+        if (end != -1) {
+            printf("%s %s\n", words[generator.sources[i]], words[end]);
+            printed++;
+        }
+    }
+    fflush(stdout);
+    pthread_mutex_destroy(&generator.lock);
+    free(generator.sources);
+    free(generator.results);
+}
+
+// Breadth-first search from source. Returns the furthest word found and sets
+// *eccentricity to its distance.
+int furthest_word(wordGraph *graph, int source, int *queue, int *stamp,
+        int currentStamp, int *distance, int *eccentricity) {
+    int head = 0, tail = 0;
+    stamp[source] = currentStamp;
+    distance[source] = 0;
+    queue[tail++] = source;
+    while (head < tail) {
+        int word = queue[head++];
+        for (int j = graph->offsets[word]; j < graph->offsets[word + 1]; j++) {
+            int neighbour = graph->neighbours[j];
+            if (stamp[neighbour] != currentStamp) {
+                stamp[neighbour] = currentStamp;
+                distance[neighbour] = distance[word] + 1;
+                queue[tail++] = neighbour;
+            }
+        }
+    }
+    *eccentricity = distance[queue[tail - 1]];
+    return queue[tail - 1];
+}
+
+void *analysis_worker(void *data) {
+    graphAnalysis *analysis = data;
+    cmdArgs *arguments = analysis->arguments;
+    wordGraph *graph = &arguments->graph;
+    int numWords = arguments->dictionaryLines;
+    int *queue = malloc(numWords * sizeof(int));
+    int *stamp = calloc(numWords, sizeof(int));
+    int *distance = malloc(numWords * sizeof(int));
+    int currentStamp = 0;
+
+    while (true) {
+        // Components come largest first and a component's diameter is less
+        // than its size, so once one cannot beat the best estimate none of
+        // the rest can either. Ties go to the earlier component so the words
+        // reported do not depend on thread timing.
+        pthread_mutex_lock(&analysis->lock);
+        int component = -1;
+        int position = analysis->nextComponent;
+        if (position < graph->numComponents) {
+            component = analysis->order[analysis->nextComponent++];
+            if (graph->componentSize[component] - 1 <= analysis->diameter) {
+                component = -1;
+                analysis->nextComponent = graph->numComponents;
+            }
+        }
+        pthread_mutex_unlock(&analysis->lock);
+        if (component == -1) {
+            break;
+        }
+
+        int eccentricity;
+        int from = furthest_word(graph, analysis->root[component], queue,
+                stamp, ++currentStamp, distance, &eccentricity);
+        int to = furthest_word(graph, from, queue, stamp, ++currentStamp,
+                distance, &eccentricity);
+        pthread_mutex_lock(&analysis->lock);
+        if (eccentricity > analysis->diameter
+                || (eccentricity == analysis->diameter
+                && position < analysis->diameterPosition)) {
+            analysis->diameter = eccentricity;
+            analysis->diameterPosition = position;
+            analysis->diameterFrom = from;
+            analysis->diameterTo = to;
+        }
+        pthread_mutex_unlock(&analysis->lock);
+    }
+    free(queue);
+    free(stamp);
+    free(distance);
+    return NULL;
+}
+
+// Prints a dictionary word as a JSON string. Nothing restricts dictionary
+// lines to letters, so quotes, backslashes and control characters are
+// escaped.
+void print_json_string(const char *str) {
+    putchar('"');
+    for (; *str; str++) {
+        unsigned char c = *str;
+        if (c == '"' || c == '\\') {
+            printf("\\%c", c);
+        } else if (c < 0x20) {
+            printf("\\u%04x", c);
+        } else {
+            putchar(c);
+        }
+    }
+    putchar('"');
+}
+
+// Prints the non-zero entries of a histogram, either as CSV rows or as a
+// JSON object member followed by a comma.
+void print_histogram(const char *name, int *counts, int numCounts, bool json) {
+    bool first = true;
+    if (json) {
+        printf("\"%s\":{", name);
+    }
+    for (int i = 0; i < numCounts; i++) {
+        if (counts[i] == 0) {
+            continue;
+        }
+        if (json) {
+            printf("%s\"%d\":%d", first ? "" : ",", i, counts[i]);
+        } else {
+            printf("%s,%d,%d\n", name, i, counts[i]);
+        }
+        first = false;
+    }
+    if (json) {
+        printf("},");
+    }
+}
+
+int *compare_component_sizes;
+
+int compare_components(const void *a, const void *b) {
+    int sizeA = compare_component_sizes[*(const int *)a];
+    int sizeB = compare_component_sizes[*(const int *)b];
+    return (sizeA < sizeB) - (sizeA > sizeB);
+}
+
+// Prints the degree histogram, component size histogram, double-sweep
+// diameter estimate and highest-degree words of the word graph as CSV or
+// JSON on stdout.
+void analyse_graph(cmdArgs *arguments) {
+    wordGraph *graph = &arguments->graph;
+    char **words = arguments->dictionaryElement;
+    int numWords = arguments->dictionaryLines;
+    int numEdges = graph->offsets[numWords] / 2;
+    int maxDegree = 0;
+    for (int i = 0; i < numWords; i++) {
+        int degree = graph->offsets[i + 1] - graph->offsets[i];
+        maxDegree = degree > maxDegree ? degree : maxDegree;
+    }
+
+    // Degree and component size histograms, and the hub words, which are
+    // kept in a small array sorted by degree.
+    int *degreeCount = calloc(maxDegree + 1, sizeof(int));
+    int *sizeCount = calloc(numWords + 1, sizeof(int));
+    int hubs[ANALYSIS_HUB_WORDS];
+    int numHubs = 0;
+    for (int i = 0; i < numWords; i++) {
+        int degree = graph->offsets[i + 1] - graph->offsets[i];
+        degreeCount[degree]++;
+        int pos = numHubs < ANALYSIS_HUB_WORDS ? numHubs++ : numHubs;
+        while (pos > 0 && degree > graph->offsets[hubs[pos - 1] + 1]
+                - graph->offsets[hubs[pos - 1]]) {
+            if (pos < ANALYSIS_HUB_WORDS) {
+                hubs[pos] = hubs[pos - 1];
+            }
+            pos--;
+        }
+        if (pos < ANALYSIS_HUB_WORDS) {
+            hubs[pos] = i;
+        }
+    }
+    for (int i = 0; i < graph->numComponents; i++) {
+        sizeCount[graph->componentSize[i]]++;
+    }
+
+    graphAnalysis analysis;
+    analysis.arguments = arguments;
+    analysis.order = malloc(graph->numComponents * sizeof(int));
+    analysis.root = malloc(graph->numComponents * sizeof(int));
+    analysis.nextComponent = 0;
+    analysis.diameter = 0;
+    analysis.diameterPosition = graph->numComponents;
+    analysis.diameterFrom = numWords > 0 ? 0 : -1;
+    analysis.diameterTo = analysis.diameterFrom;
+    pthread_mutex_init(&analysis.lock, NULL);
+    for (int i = numWords - 1; i >= 0; i--) {
+        analysis.root[graph->component[i]] = i;
+    }
+    for (int i = 0; i < graph->numComponents; i++) {
+        analysis.order[i] = i;
+    }
+    compare_component_sizes = graph->componentSize;
+    qsort(analysis.order, graph->numComponents, sizeof(int),
+            compare_components);
+
+    run_worker_threads(arguments, analysis_worker, &analysis);
+
+    char *from = analysis.diameterFrom == -1 ? "" : words[analysis.diameterFrom];
+    char *to = analysis.diameterTo == -1 ? "" : words[analysis.diameterTo];
+    bool json = strcmp(arguments->analyse, "json") == 0;
+    if (json) {
+        printf("{\"words\":%d,\"edges\":%d,\"components\":%d,"
+                "\"diameter\":{\"estimate\":%d,\"from\":", numWords, numEdges,
+                graph->numComponents, analysis.diameter);
+        print_json_string(from);
+        printf(",\"to\":");
+        print_json_string(to);
+        printf("},");
+    } else {
+        printf("metric,key,value\nwords,,%d\nedges,,%d\ncomponents,,%d\n"
+                "diameter,%s-%s,%d\n", numWords, numEdges,
+                graph->numComponents, from, to, analysis.diameter);
+    }
+    print_histogram(json ? "degrees" : "degree", degreeCount, maxDegree + 1,
+            json);
+    print_histogram(json ? "componentSizes" : "component_size", sizeCount,
+            numWords + 1, json);
+    if (json) {
+        printf("\"hubs\":[");
+    }
+    for (int i = 0; i < numHubs; i++) {
+        char *hub = words[hubs[i]];
+        int degree = graph->offsets[hubs[i] + 1] - graph->offsets[hubs[i]];
+        if (json) {
+            printf("%s{\"word\":", i ? "," : "");
+            print_json_string(hub);
+            printf(",\"degree\":%d}", degree);
+        } else {
+            printf("hub,%s,%d\n", hub, degree);
+        }
+    }
+    if (json) {
+        printf("]}\n");
+    }
+    fflush(stdout);
+
+    pthread_mutex_destroy(&analysis.lock);
+    free(analysis.order);
+    free(analysis.root);
+    free(degreeCount);
+    free(sizeCount);
+}
+
 int main(int argc, char *argv[]) {
     cmdArgs arguments;
     command_line_arguments(argc, argv, &arguments);
 
-    if (arguments.startWord == NULL || arguments.destWord == NULL || arguments.dictionary == NULL) {
+    if (arguments.generate > 0 && arguments.steps < 0) {
+        fprintf(stderr, "%s\n", GENERATE_NEEDS_STEPS);
+        exit(EXIT_STATUS_4);
+    }
+
+    // With only --delta, the dictionary is updated and no puzzle is needed.
+    bool deltaOnly = arguments.delta != NULL && arguments.startWord == NULL
+            && arguments.destWord == NULL && arguments.generate == 0
+            && arguments.analyse == NULL;
+    if ((arguments.generate == 0 && arguments.analyse == NULL && !deltaOnly
+            && (arguments.startWord == NULL || arguments.destWord == NULL))
+            || arguments.dictionary == NULL) {
         fprintf(stderr, "%s\n", INVALID_COMMAND_LINE_ARGUMENT_4);
         exit(EXIT_STATUS_4);
     }
 
     length_valid(arguments.len);
 
+    struct timespec phaseStart;
+    clock_gettime(CLOCK_MONOTONIC, &phaseStart);
     open_file(arguments.dictionary, &arguments.dictionaryElement, &arguments.dictionaryLines);
+    report_phase(&arguments, "load", &phaseStart, arguments.dictionaryLines);
 
     for (int i = 0; i < arguments.dictionaryLines; i++) {
         word_length_valid(arguments.dictionaryElement[i]);
         string_length_comparison(arguments.dictionaryElement[i], arguments.len);
     }
+    build_word_index(&arguments);
+
+    // The delta's words are checked as they are applied, so the dictionary
+    // is only saved once it is known to be valid.
+    if (arguments.delta != NULL) {
+        apply_delta_file(&arguments);
+        save_dictionary(&arguments);
+        if (deltaOnly) {
+            report_phase(&arguments, "delta", &phaseStart,
+                    arguments.dictionaryLines);
+            exit(EXIT_GAME_WON);
+        }
+    }
+    build_bloom_filter(&arguments);
+    report_phase(&arguments, "index", &phaseStart, arguments.dictionaryLines);
+
+    if (arguments.generate > 0 || arguments.analyse != NULL) {
+        build_word_graph(&arguments);
+        label_components(&arguments);
+        report_phase(&arguments, "graph", &phaseStart,
+                arguments.graph.offsets[arguments.dictionaryLines]);
+        if (arguments.generate > 0) {
+            generate_puzzles(&arguments);
+            report_phase(&arguments, "generate", &phaseStart,
+                    arguments.dictionaryLines);
+        } else {
+            analyse_graph(&arguments);
+            report_phase(&arguments, "analyse", &phaseStart,
+                    arguments.dictionaryLines);
+        }
+        report_bloom(&arguments);
+        exit(EXIT_GAME_WON);
+    }
 
     string_string_comparison(arguments.startWord, arguments.destWord);
 
-    start_end_check(&arguments, arguments.dictionaryLines, arguments.dictionaryElement);
+    arguments.index.probes = 0;
+    start_end_check(&arguments);
+    report_phase(&arguments, "search", &phaseStart, arguments.index.probes);
+    report_bloom(&arguments);
 
     exit(EXIT_GAME_WON);
 }
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -11,6 +12,15 @@
 #include <sys/types.h>
 #include <errno.h>
 #include <time.h>
+#include <limits.h>
+#include <poll.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <spawn.h>
+#include <sys/resource.h>
+#include <math.h>
+#include <stdint.h>
+#include <inttypes.h>
 
 
 // Enum for storing command line errors
@@ -18,6 +28,18 @@ typedef enum {
     COMMAND_LINE_ERROR_EXIT = 9
 } CommandLineErrors;
 
+// Values of options that aren't given on the command line
+#define DEFAULT_JOBS 1  // Number of tests run at once without --jobs.
+#define DEFAULT_TIMEOUT_MS 1500  // Time a test may run without --timeout.
+#define DEFAULT_BENCH_THRESHOLD 10  // Percent slower that fails --bench.
+#define DEFAULT_FUZZ_SEED 1
+
+// Wall time a program under --cpu-limit is given past its hard CPU limit
+// before it is killed as timed out, so that it can be killed for CPU first.
+#define CPU_LIMIT_GRACE_MS 1000
+
+extern char **environ;
+
 // Enum for job file errors
 typedef enum {
     JOB_SPEC_FILE_ERROR = 8,  // Error for opening job specification file.
@@ -30,68 +52,337 @@ typedef enum {
 // Enum for expected outputs
 typedef enum {
     DIRECTORY_MAKE_ERROR = 3,
-    OPEN_FILE_ERROR = 11
+    OPEN_FILE_ERROR = 11,
+    EXPECTED_STDOUT = 0,
+    EXPECTED_STDERR = 1,
+    EXPECTED_EXIT_STATUS = 2,
+    NUM_EXPECTED_FILES = 3
 } ExpectedOutputs;
 
+// Name of the file in --dir recording what each test's expected outputs were
+// generated from.
+#define MANIFEST_FILE_NAME "manifest"
+// Name of the file in --dir recording each test's last result and duration.
+#define HISTORY_FILE_NAME "history"
+// Names of the files in --dir holding the expected outputs with --pack.
+#define PACK_FILE_NAME "pack"
+#define PACK_INDEX_FILE_NAME "pack.index"
+// Header line of a tab separated --report file, which --merge reads back.
+#define RESULTS_REPORT_HEADER "id\tpassed\texit_status\tsignal\twall_ms\t" \
+        "user_ms\tsys_ms\tmax_rss_kb\tstdout_bytes\tstderr_bytes\t" \
+        "stdout_mismatch\tstderr_mismatch\tslower\tverdict"
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+// Suffixes of the expected output files, indexed by ExpectedOutputs.
+static const char *const expectedFileSuffixes[NUM_EXPECTED_FILES] = {
+    "stdout", "stderr", "exitstatus"
+};
+
 // Enum for running test jobs
 typedef enum {
     READ_END = 0,
     WRITE_END = 1,
     PROCESS_A_EXIT = 97,
-    PROCESS_B_EXIT = 98,
-    PROCESS_C_EXIT = 99,
-    PROCESS_A_INDEX = 0,
-    PROCESS_B_INDEX = 1,
-    PROCESS_C_INDEX = 2,
+    STDOUT_STREAM = 0,
+    STDERR_STREAM = 1,
+    NUM_OUTPUT_STREAMS = 2,
+    POLL_SOURCES_PER_JOB = 3,  // The program's pidfd and its two pipes.
+    DESCRIPTORS_PER_JOB = 3,  // Held by a running test between polls.
+    // Held outside the running tests: stdio, the job file, and the extra
+    // pipe ends and expected output file of a test being started.
+    RESERVED_DESCRIPTORS = 16,
+    READ_CHUNK_SIZE = 65536,
+    // --showdiff compares at most this much of each output, from the line
+    // holding the first mismatch.
+    DIFF_WINDOW_BYTES = 65536,
+    DIFF_WINDOW_LINES = 256,
+    DIFF_CONTEXT_LINES = 2,  // Matching lines shown around each difference.
     OUTPUT_MATCHED = 0,
     OUTPUT_DIFFERENT = 1
 } RunningTestJobs;
 
+// Enum for how a test's program ended, apart from the outputs it produced
+typedef enum {
+    VERDICT_COMPLETED = 0,  // Exited normally; judged on its outputs.
+    VERDICT_TIMEOUT,  // Killed at its deadline.
+    VERDICT_CPU,  // Exceeded --cpu-limit.
+    VERDICT_MEMORY,  // Failed after using most of --mem-limit.
+    VERDICT_OUTPUT,  // Killed for writing more than --output-limit bytes.
+    VERDICT_SIGNAL,  // Killed by any other signal.
+    NUM_VERDICTS
+} TestVerdict;
+
+// Names of the verdicts in the --report file (passed or failed for a
+// completed test), and the result lines printed for them.
+static const char *const verdictNames[NUM_VERDICTS] = {
+    "failed", "timeout", "cpu", "memory", "output", "signal"
+};
+static const char *const verdictMessages[NUM_VERDICTS] = {
+    NULL, "Timed out", "CPU time limit exceeded", "Out of memory",
+    "Output limit exceeded", "Killed by signal"
+};
+
 // Enum for reporting overall test result
 typedef enum {
     OVERALL_TEST_RESULT_PASS = 0,
     OVERALL_TEST_RESULT_FAIL = 7
 } ReportOverallResult;
 
+// Enum for generating --fuzz cases
+typedef enum {
+    FUZZ_NUM_OPTIONS = 5,
+    FUZZ_MAX_MUTATIONS = 3,  // Changes made to a valid command line.
+    FUZZ_MAX_ARGS = 2 * (FUZZ_NUM_OPTIONS + FUZZ_MAX_MUTATIONS),
+    FUZZ_MAX_LINES = 8,  // Lines of standard input in one case.
+    FUZZ_MAX_WORD_LENGTH = 10,
+    FUZZ_WORD_LENGTH = 4,  // Length of the fuzz dictionary's words.
+    FUZZ_DICTIONARY_WORDS = 400
+} FuzzTesting;
+
+// Letters of the generated words. Few letters make ladders between the
+// dictionary words likely.
+#define FUZZ_ALPHABET "abcdef"
+// Characters that aren't valid in a word.
+#define FUZZ_BAD_CHARACTERS "A1-?Z "
+
+// Options of uqwordladder given in --fuzz cases, and the values tried for
+// its integer options.
+typedef enum {
+    FUZZ_START, FUZZ_END, FUZZ_LEN, FUZZ_LIMIT, FUZZ_DICTIONARY
+} FuzzOption;
+static const char *const fuzzOptions[FUZZ_NUM_OPTIONS] = {
+    "--start", "--end", "--len", "--limit", "--dictionary"
+};
+static const char *const fuzzNumbers[] = {
+    "-1", "0", "1", "2", "3", "4", "5", "9", "10", "55", "x", "4a", "+3"
+};
+#define FUZZ_NUM_NUMBERS (sizeof(fuzzNumbers) / sizeof(fuzzNumbers[0]))
+
 // Struct for command line args
 typedef struct {
     char *dir;
     bool regen;
     char *jobFile;  // Name of the job file containing tests
     char *program;  // Name of the program to execute
+    int jobs;  // Maximum number of tests to run at once.
+    long timeoutMs;  // Time a test may run before it is killed.
+    char *report;  // File to write per-test results to, or NULL.
+    int showDiff;  // Differing lines to show per output, or 0.
+    bool prioritise;  // Order tests by their history (--prioritise).
+    bool failFast;  // Stop starting tests after the first failure.
+    bool pack;  // Keep expected outputs in the pack file (--pack).
+    int benchRuns;  // Runs of each program per test for --bench, or 0.
+    double benchThreshold;  // Percent slower than the reference that fails.
+    int fuzzCases;  // Random cases to generate for --fuzz, or 0.
+    int fuzzSeed;  // Seed the --fuzz cases are generated from.
+    // With --shard i/n, only the tests in shard i (from 1) of n are run;
+    // shardCount is 0 without --shard.
+    int shardIndex;
+    int shardCount;
+    // Limits on each test program, or 0 for none: CPU seconds, address
+    // space in bytes, and bytes written to stdout and stderr together.
+    int cpuLimit;
+    rlim_t memoryLimit;
+    size_t outputLimit;
+    bool quiet;  // Don't print each test's result lines.
 } CommandLineArgs;
 
 // Struct to hold individual test information
 typedef struct {
     char *testID;  // Holds the test ID (can be a string).
     char *testInputFileName;  // Input file name for the test.
-    FILE *testInputFileHandler;  // Input file handler.
     char **testArgs;  // Arguments for the test.
     int testArgsCount;  // Number of arguments for the test.
+    long timeoutMs;  // Time limit from a "#timeout" line, or 0 if none.
     
     // For pipes:
     int standardOutCmp[2];  // Handles standard output comparison.
     int standardErrorCmp[2];  // Handles standard error comparison.
     
-    // File descriptors for test and expected files:
-    FILE *testStandOutFileHandler;
-    FILE *testStandErrorFileHandler;
-    FILE *testExitStatusFileHandler;
-    FILE *goodStandOutFileHandler;
-    FILE *goodStandErrorFileHandler;
-    FILE *goodExitStatusFileHandler;
     int goodExitStatus;  // Stores the good exit status.
+    // Hash of the arguments, input file and good-uqwordladder binary.
+    uint64_t expectedHash;
+    // With --pack, where the expected stdout and stderr are in the pack file
+    // and the hashes of their contents.
+    uint64_t packOffset[NUM_OUTPUT_STREAMS];
+    uint64_t packLength[NUM_OUTPUT_STREAMS];
+    uint64_t contentHash[NUM_OUTPUT_STREAMS];
+
+    // Offsets of the first byte of stdout and stderr that differed from the
+    // expected output, or -1 if the output matched.
+    long standardOutMismatch;
+    long standardErrorMismatch;
+
+    // Result and wall time of the last run, from the history file.
+    int previousResult;  // 1 if it passed, 0 if it failed, -1 if unknown.
+    long long previousWallNs;
+    bool regenerated;  // Whether its expected outputs were just regenerated.
+
+    // Outcome and resource use of the test program, for the --report file.
+    bool passed;
+    int waitStatus;
+    long long wallNs;
+    struct rusage usage;
+    size_t standardOutBytes;
+    size_t standardErrorBytes;
+    bool slower;  // Whether --bench found it slower than good-uqwordladder.
+    int verdict;  // How the program ended (VERDICT_COMPLETED, etc.).
+
+    // Result lines for the test, held until earlier tests have printed.
+    char *report;
+    size_t reportSize;
+    bool finished;
 } IndividualTest;
 
 // Struct to hold test file list
 typedef struct {
     int numTests;  // Number of tests in the job file.
+    int capacity;  // Number of tests the tests array has room for.
     IndividualTest *tests;  // Reference to IndividualTest structs.
     int testsCompleted;
     int testsPassed;  // Number of passed tests.
     int testsFailed;  // Number of failed tests.
+    int benchRegressions;  // Tests slower than good-uqwordladder.
+    char *pack;  // The mmap'd pack file with --pack, or NULL.
+    size_t packSize;
 } TestFileList;
 
+// Struct for an open-addressing hash set of strings. The set does not own
+// the strings; they belong to the tests they were taken from.
+typedef struct {
+    char **slots;  // NULL for an empty slot.
+    size_t capacity;  // Always a power of two.
+    size_t count;
+} StringSet;
+
+// Struct for one line of the expected output manifest
+typedef struct {
+    char *testId;
+    uint64_t expectedHash;
+} ManifestEntry;
+
+// Struct for the expected output manifest, sorted by test ID
+typedef struct {
+    ManifestEntry *entries;
+    int numEntries;
+} Manifest;
+
+// Struct for a blob of expected output in the pack file
+typedef struct {
+    uint64_t contentHash;
+    uint64_t offset;
+    uint64_t length;  // 0 marks an empty slot; empty outputs aren't stored.
+} PackBlob;
+
+// Struct for one line of the pack index
+typedef struct {
+    char *testId;
+    uint64_t expectedHash;
+    int exitStatus;
+    uint64_t offset[NUM_OUTPUT_STREAMS];
+    uint64_t length[NUM_OUTPUT_STREAMS];
+    uint64_t contentHash[NUM_OUTPUT_STREAMS];
+} PackEntry;
+
+// Struct for the packed expected output store used with --pack. Outputs are
+// appended to one pack file, each distinct output only once, and the index
+// records where each test's outputs are.
+typedef struct {
+    int fd;  // The pack file, open for reading and appending.
+    uint64_t size;
+    PackBlob *blobs;  // Open-addressing table keyed by content hash.
+    size_t blobCapacity;  // Always a power of two.
+    size_t numBlobs;
+    PackEntry *entries;  // The index read at startup, sorted by test ID.
+    int numEntries;
+} PackStore;
+
+// Struct for one line of the test history file
+typedef struct {
+    char *testId;
+    int passed;
+    long long wallNs;
+} HistoryEntry;
+
+// Struct for the statistics of a set of benchmark samples
+typedef struct {
+    long long median;
+    long long low;  // Bounds of the 95% confidence interval of the median.
+    long long high;
+    long long p95;
+} SampleSummary;
+
+// Struct for comparing one output stream of a running test with its expected
+// output as the stream is read
+typedef struct {
+    int fd;  // Read end of the output pipe, or -1 once it is closed.
+    char *expected;  // The mmap'd expected output, or NULL if it is empty.
+    size_t expectedSize;
+    bool mapped;  // Whether expected is a mapping of its own to unmap.
+    size_t bytesRead;
+    long mismatchOffset;  // Offset of the first differing byte, or -1.
+
+    // For --showdiff: the output from the start of the line holding the
+    // first mismatch, up to DIFF_WINDOW_BYTES, and the diff made from it.
+    int showDiff;
+    char *window;
+    size_t windowStart;  // Offset of the window in the output.
+    size_t windowSize;
+    char *diff;  // NULL if there is no diff to show.
+    size_t diffSize;
+} OutputComparison;
+
+// Struct for a test that has been started and not yet finished
+typedef struct {
+    int testIndex;  // Index of the test in the TestFileList.
+    pid_t pid;  // Process ID of the program, or -1 once it has been reaped.
+    int pidfd;  // Readable when the program exits.
+    int waitStatus;
+    // VERDICT_TIMEOUT or VERDICT_OUTPUT if the harness killed the program,
+    // otherwise VERDICT_COMPLETED.
+    int killedFor;
+    OutputComparison streams[NUM_OUTPUT_STREAMS];
+    struct timespec started;
+    struct timespec deadline;  // When the program is killed.
+    long long wallNs;  // Time from start until the program was reaped.
+    struct rusage usage;
+} RunningJob;
+
+// Struct for a --fuzz case: the arguments and standard input given to both
+// programs. All the strings are owned by the case.
+typedef struct {
+    char *args[FUZZ_MAX_ARGS];
+    int numArgs;
+    char *lines[FUZZ_MAX_LINES];
+    int numLines;
+} FuzzCase;
+
+/*
+limit_jobs_to_descriptors():
+----------------------------
+Caps the number of tests run at once so their descriptors fit within
+RLIMIT_NOFILE. Descriptors are only opened while a test runs, so this is
+the harness's whole descriptor budget however long the job file is.
+
+arg1: parameters - The CommandLineArgs struct holding the --jobs value.
+
+Returns: None
+Errors: None
+*/
+void limit_jobs_to_descriptors(CommandLineArgs *parameters) {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == -1
+            || limit.rlim_cur == RLIM_INFINITY) {
+        return;
+    }
+    long budget = ((long)limit.rlim_cur - RESERVED_DESCRIPTORS)
+            / DESCRIPTORS_PER_JOB;
+    if (parameters->jobs > budget) {
+        parameters->jobs = budget > 1 ? budget : 1;
+    }
+}
+
 /* command_line_error():
 ----------------------
 Handles command line errors by printing the correct usage and exiting the program.
@@ -101,14 +392,111 @@ Returns: None.
 void command_line_error(void) {
     fprintf(stderr,
             "Usage: testuqwordladder [--showdiff N] [--dir dir] "
-            "[--regen] jobspecfile program\n");
+            "[--regen] [--jobs N] [--timeout seconds] [--report file] "
+            "[--bench R] [--threshold percent] [--prioritise] [--fail-fast] "
+            "[--pack] [--fuzz N [--seed S]] [--shard i/n] [--cpu-limit seconds] "
+            "[--mem-limit MiB] [--output-limit bytes] jobspecfile program\n"
+            "   or: testuqwordladder --merge [--report file] reportfile ...\n");
     exit(COMMAND_LINE_ERROR_EXIT);
 }
 
+/*
+parse_positive_integer():
+-------------------------
+Converts a command line argument made up only of digits to a positive int.
+
+arg1: str - The argument to convert.
+
+Returns: The value of the argument.
+Errors: Calls command_line_error() if the argument is not a positive integer.
+*/
+int parse_positive_integer(char *str) {
+    char *end;
+    if (str[0] < '0' || str[0] > '9') {
+        command_line_error();
+    }
+    long value = strtol(str, &end, 10);
+    if (*end != '\0' || value <= 0 || value > INT_MAX) {
+        command_line_error();
+    }
+    return value;
+}
+
+/*
+parse_threshold():
+------------------
+Converts a command line argument to a non-negative percentage.
+
+arg1: str - The argument to convert.
+
+Returns: The percentage, or -1 if the argument is not a valid percentage.
+Errors: None
+*/
+double parse_threshold(char *str) {
+    char *end;
+    if ((str[0] < '0' || str[0] > '9') && str[0] != '.') {
+        return -1;
+    }
+    double percent = strtod(str, &end);
+    if (*end != '\0' || !isfinite(percent)) {
+        return -1;
+    }
+    return percent;
+}
+
+/*
+parse_timeout():
+----------------
+Converts a time limit in seconds, which may have a fractional part, to
+milliseconds.
+
+arg1: str - The time limit to convert.
+
+Returns: The time limit in milliseconds, or -1 if str is not a positive
+         number of seconds.
+*/
+long parse_timeout(char *str) {
+    char *end;
+    if ((str[0] < '0' || str[0] > '9') && str[0] != '.') {
+        return -1;
+    }
+    double seconds = strtod(str, &end);
+    if (*end != '\0' || seconds <= 0 || seconds > LONG_MAX / 1000) {
+        return -1;
+    }
+    long timeoutMs = seconds * 1000 + 0.5;
+    return timeoutMs > 0 ? timeoutMs : 1;
+}
+
+/*
+parse_shard():
+--------------
+Parses the "i/n" argument of --shard, where 1 <= i <= n.
+
+arg1: str - The string to parse.
+arg2: parameters - The CommandLineArgs struct to set shardIndex and
+      shardCount in.
+
+Returns: true if the string is a valid shard, otherwise false.
+Errors: Exits with exit status 9 if i or n isn't a positive integer.
+*/
+bool parse_shard(char *str, CommandLineArgs *parameters) {
+    char *slash = strchr(str, '/');
+    if (slash == NULL) {
+        return false;
+    }
+    *slash = '\0';
+    parameters->shardIndex = parse_positive_integer(str);
+    parameters->shardCount = parse_positive_integer(slash + 1);
+    *slash = '/';
+    return parameters->shardIndex <= parameters->shardCount;
+}
+
 /* command_line_arguments
 Handles and validates command-line arguments and populates the commandLineArgs
 struct with detauls on the directory, whether to regenerate expected output
-files, the job file, and the program to execute.
+files, how many tests to run at once and for how long, the limits on each
+test program, the --fuzz cases, the job file, and the program to execute.
 
 arg1: argc - The number of command-line arguments.
 arg2: argv[] - An array of command-line arguments.
@@ -122,7 +510,7 @@ Errors: Iv invalid arguments are present, this function calls
 void command_line_arguments(int argc, char *argv[], 
 CommandLineArgs *parameters) {
     // Validate the number of arguments
-    if (argc < 3 || argc > 6) {
+    if (argc < 3) {
         command_line_error();
     }
     
@@ -131,9 +519,29 @@ CommandLineArgs *parameters) {
     parameters->regen = false;
     parameters->jobFile = NULL;
     parameters->program = NULL;
+    parameters->jobs = DEFAULT_JOBS;
+    parameters->timeoutMs = DEFAULT_TIMEOUT_MS;
+    parameters->report = NULL;
+    parameters->showDiff = 0;
+    parameters->prioritise = false;
+    parameters->failFast = false;
+    parameters->pack = false;
+    parameters->benchRuns = 0;
+    parameters->benchThreshold = DEFAULT_BENCH_THRESHOLD;
+    parameters->fuzzCases = 0;
+    parameters->fuzzSeed = 0;
+    parameters->shardIndex = 0;
+    parameters->shardCount = 0;
+    parameters->cpuLimit = 0;
+    parameters->memoryLimit = 0;
+    parameters->outputLimit = 0;
+    parameters->quiet = false;
+    bool thresholdGiven = false;
     
     bool dirGiven = false;
     bool regenGiven = false;
+    bool jobsGiven = false;
+    bool timeoutGiven = false;
     
     //Make the and second last arguments the program and jobFile respectively.
     parameters->program = argv[argc - 1];
@@ -144,7 +552,7 @@ CommandLineArgs *parameters) {
         command_line_error();
     }
     
-    // Check for optional --dir and --regen flags (if argc is larger than 3)
+    // Check for optional flags (if argc is larger than 3)
     if (argc > 3) {
         for (int i = 1; i < argc - 2; i++) {
             if (strcmp(argv[i], "--dir") == 0) {
@@ -160,6 +568,99 @@ CommandLineArgs *parameters) {
                 }
                 parameters->regen = true;
                 regenGiven = true;
+            } else if (strcmp(argv[i], "--jobs") == 0) {
+                if (jobsGiven || i == argc - 3) {
+                    command_line_error();
+                }
+                parameters->jobs = parse_positive_integer(argv[i + 1]);
+                jobsGiven = true;
+                i++;
+            } else if (strcmp(argv[i], "--timeout") == 0) {
+                if (timeoutGiven || i == argc - 3
+                        || (parameters->timeoutMs
+                        = parse_timeout(argv[i + 1])) == -1) {
+                    command_line_error();
+                }
+                timeoutGiven = true;
+                i++;
+            } else if (strcmp(argv[i], "--report") == 0) {
+                if (parameters->report != NULL || i == argc - 3) {
+                    command_line_error();
+                }
+                parameters->report = argv[i + 1];
+                i++;
+            } else if (strcmp(argv[i], "--showdiff") == 0) {
+                if (parameters->showDiff || i == argc - 3) {
+                    command_line_error();
+                }
+                parameters->showDiff = parse_positive_integer(argv[i + 1]);
+                i++;
+            } else if (strcmp(argv[i], "--prioritise") == 0) {
+                if (parameters->prioritise) {
+                    command_line_error();
+                }
+                parameters->prioritise = true;
+            } else if (strcmp(argv[i], "--fail-fast") == 0) {
+                if (parameters->failFast) {
+                    command_line_error();
+                }
+                parameters->failFast = true;
+            } else if (strcmp(argv[i], "--pack") == 0) {
+                if (parameters->pack) {
+                    command_line_error();
+                }
+                parameters->pack = true;
+            } else if (strcmp(argv[i], "--bench") == 0) {
+                if (parameters->benchRuns || i == argc - 3) {
+                    command_line_error();
+                }
+                parameters->benchRuns = parse_positive_integer(argv[i + 1]);
+                i++;
+            } else if (strcmp(argv[i], "--threshold") == 0) {
+                if (thresholdGiven || i == argc - 3
+                        || (parameters->benchThreshold
+                        = parse_threshold(argv[i + 1])) == -1) {
+                    command_line_error();
+                }
+                thresholdGiven = true;
+                i++;
+            } else if (strcmp(argv[i], "--fuzz") == 0) {
+                if (parameters->fuzzCases || i == argc - 3) {
+                    command_line_error();
+                }
+                parameters->fuzzCases = parse_positive_integer(argv[i + 1]);
+                i++;
+            } else if (strcmp(argv[i], "--seed") == 0) {
+                if (parameters->fuzzSeed || i == argc - 3) {
+                    command_line_error();
+                }
+                parameters->fuzzSeed = parse_positive_integer(argv[i + 1]);
+                i++;
+            } else if (strcmp(argv[i], "--shard") == 0) {
+                if (parameters->shardCount || i == argc - 3
+                        || !parse_shard(argv[i + 1], parameters)) {
+                    command_line_error();
+                }
+                i++;
+            } else if (strcmp(argv[i], "--cpu-limit") == 0) {
+                if (parameters->cpuLimit || i == argc - 3) {
+                    command_line_error();
+                }
+                parameters->cpuLimit = parse_positive_integer(argv[i + 1]);
+                i++;
+            } else if (strcmp(argv[i], "--mem-limit") == 0) {
+                if (parameters->memoryLimit || i == argc - 3) {
+                    command_line_error();
+                }
+                parameters->memoryLimit = (rlim_t)parse_positive_integer(
+                        argv[i + 1]) << 20;
+                i++;
+            } else if (strcmp(argv[i], "--output-limit") == 0) {
+                if (parameters->outputLimit || i == argc - 3) {
+                    command_line_error();
+                }
+                parameters->outputLimit = parse_positive_integer(argv[i + 1]);
+                i++;
             } else {
                 command_line_error();
             }
@@ -170,6 +671,14 @@ CommandLineArgs *parameters) {
     if (!dirGiven) {
         parameters->dir = "./tmp";
     }
+    // --seed only chooses the --fuzz cases.
+    if (parameters->fuzzSeed && !parameters->fuzzCases) {
+        command_line_error();
+    }
+    if (!parameters->fuzzSeed) {
+        parameters->fuzzSeed = DEFAULT_FUZZ_SEED;
+    }
+    limit_jobs_to_descriptors(parameters);
 }
 
 
@@ -230,6 +739,32 @@ void syntax_error(char *jobFile, int lineNum) {
     exit(SYNTAX_ERROR);
 }
 
+/*
+timeout_directive():
+--------------------
+Checks whether a comment line is a "#timeout seconds" directive, which sets
+the time limit of the job on the next non-comment line.
+
+arg1: jobFile - The path of the job file being read.
+arg2: lineNum - The line number of the comment in the job file.
+arg3: line - The comment line.
+
+Returns: The time limit in milliseconds, or 0 if the line is an ordinary
+         comment.
+Errors: Calls syntax_error() if the directive's time limit is invalid.
+*/
+long timeout_directive(char *jobFile, int lineNum, char *line) {
+    const char *directive = "#timeout ";
+    if (strncmp(line, directive, strlen(directive)) != 0) {
+        return 0;
+    }
+    long timeoutMs = parse_timeout(line + strlen(directive));
+    if (timeoutMs == -1) {
+        syntax_error(jobFile, lineNum);
+    }
+    return timeoutMs;
+}
+
 /*
 check_syntax_error():
 ---------------------
@@ -293,53 +828,120 @@ void same_test_id_error(char *jobFile, int lineNum) {
 }
 
 /*
-check_new_test_id():
---------------------
-This function will take in the testID array, and the number of test IDs
-in the array (int testIdCount). It will then iterate through this array and 
-check whether a given testID is already in the array.
+hash_bytes():
+-------------
+Adds bytes to a 64-bit FNV-1a hash.
 
-arg1: testIdArray - The array of existing test IDs.
-arg2: testIdCount - The number of test IDs in the array.
-arg3: testId - The new test ID to check.
+arg1: hash - The hash so far.
+arg2: data - The bytes to add.
+arg3: size - The number of bytes.
 
-Returns: True if the test ID is new, false otherwise.
+Returns: The updated hash.
+*/
+uint64_t hash_bytes(uint64_t hash, const void *data, size_t size) {
+    const unsigned char *bytes = data;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+/*
+string_set_slot():
+------------------
+Finds the slot of a string in a StringSet using linear probing.
+
+arg1: set - The set to search.
+arg2: string - The string to look for.
+
+Returns: The slot holding the string, or the empty slot where it belongs.
 */
+char **string_set_slot(StringSet *set, char *string) {
+    size_t mask = set->capacity - 1;
+    size_t slot = hash_bytes(FNV_OFFSET_BASIS, string, strlen(string)) & mask;
+    while (set->slots[slot] != NULL && strcmp(set->slots[slot], string) != 0) {
+        slot = (slot + 1) & mask;
+    }
+    return &set->slots[slot];
+}
+
+/*
+string_set_add():
+-----------------
+Adds a string to a StringSet, doubling the table once it is half full.
 
-bool check_new_test_id(char **testIggdArray, int testIdCount, char *testId) {
-    if (testIdCount > 0) {
-        for (int i = 0; i < testIdCount; i++) {
-            if (strcmp(testIdArray[i], testId) == 0) {
-                return false;
+arg1: set - The set to add to.
+arg2: string - The string to add. It must outlive the set.
+
+Returns: true if the string was added, false if it was already in the set.
+*/
+bool string_set_add(StringSet *set, char *string) {
+    if ((set->count + 1) * 2 > set->capacity) {
+        StringSet grown = {calloc(set->capacity * 2, sizeof(char *)),
+                set->capacity * 2, set->count};
+        for (size_t i = 0; i < set->capacity; i++) {
+            if (set->slots[i] != NULL) {
+                *string_set_slot(&grown, set->slots[i]) = set->slots[i];
             }
         }
+        free(set->slots);
+        *set = grown;
     }
+    char **slot = string_set_slot(set, string);
+    if (*slot != NULL) {
+        return false;
+    }
+    *slot = string;
+    set->count++;
     return true;
 }
 
+/*
+check_new_test_id():
+--------------------
+Checks whether a test ID has already been used in the job file, and records
+it if not. The IDs are kept in a hash set so that checking the whole job
+file takes time proportional to its length.
+
+arg1: testIds - The set of test IDs seen so far.
+arg2: testId - The new test ID to check. It must outlive the set.
+
+Returns: True if the test ID is new, false otherwise.
+*/
+bool check_new_test_id(StringSet *testIds, char *testId) {
+    return string_set_add(testIds, testId);
+}
+
 /*
 input_file_open_check():
 ------------------------
-Checks if  a given file can be opened for reading. 
+Checks if  a given file can be opened for reading. Each file is only
+checked the first time it appears in the job file.
 
 arg1: jobFile - The path of the job file being checked.
 arg2: inputFile - The path of the input file to check.
 arg3: lineNum - The current line number in the job file.
+arg4: checkedFiles - The set of input files already checked. inputFile is
+      added to it, so it must outlive the set.
 
 Returns: None
 Errors: If the file cannot be opened, this function will print an error
         message to stderr and exit with status 13.
 
 */
-void input_file_open_check(char *jobFile, char *inputFile, int lineNum) {
-    FILE *inputFileHandler;
-    if ((inputFileHandler = fopen(inputFile, "r")) == NULL) {
+void input_file_open_check(char *jobFile, char *inputFile, int lineNum,
+        StringSet *checkedFiles) {
+    int inputFD;
+    if (!string_set_add(checkedFiles, inputFile)) {
+        return;
+    }
+    if ((inputFD = open(inputFile, O_RDONLY | O_CLOEXEC)) == -1) {
         fprintf(stderr, 
                 "testuqwordladder: Unable to open file \"%s\" specified "
                 "on line %d of file \"%s\"\n", inputFile, lineNum, jobFile);
         exit(INPUT_FILE_ERROR);
     }
-    fclose(inputFileHandler);
+    close(inputFD);
 }
 
 /*
@@ -373,67 +975,57 @@ void free_two_dimensional_array(char **array) {
     free(array);
 }
 
-/*
-free_test_id_array():
----------------------
-Frees the memory allocated for a given array of test IDs.
-
-arg1: array - The array of test IDs to free.
-arg2: testIdCount - The number of test IDs in the array.
-
-Returns: None
-*/
-void free_test_id_array(char **array, int testIdCount) {
-    for (int i = 0; i < testIdCount; i++) {
-        free(array[i]);
-    }
-    free(array);
-}
-
 
 /*
 create_new_individual_test():
 -----------------------------
-Creates a new IndividualTest struct from an array (char **fields).
-
+Creates a new IndividualTest struct from an array (char **fields). The
+argument array and copies of all the fields are made in a single
+allocation, which testArgs points to the start of, so a large job file
+costs one allocation per test.
 
 arg1: fields - The array of fields to populate the IndividualTest struct.
 
-Returns: An IndividualTest struct populated with the given fields.
+Returns: An IndividualTest struct populated with the given fields, or one
+         with a NULL testID if fields doesn't hold the two mandatory fields.
 */
 IndividualTest create_new_individual_test(char **fields) {
     // Create a copy of the individualTest struct. 
     IndividualTest test;
 
-    // Initialize variables in the struct with placeholder values. 
-    test.testID = NULL;
-    test.testInputFileName = NULL;
-    test.testInputFileHandler = NULL;
-    test.testArgsCount = 0;
-    test.testArgs = NULL;
-
-    // Copy testID and testInputFileName into the struct.
-    test.testID = strdup(fields[0]);
-    test.testInputFileName = strdup(fields[1]);
-
-    // Create a file handler for the input file. 
-    test.testInputFileHandler = fopen(test.testInputFileName, "r");
-
-    // Count total elements in fields array. 
+    // Count total elements in fields array, and the space needed for
+    // copies of them.
     int fieldCount = 0;
+    size_t stringsSize = 0;
     while (fields[fieldCount] != NULL) {
-        fieldCount++;
+        stringsSize += strlen(fields[fieldCount++]) + 1;
+    }
+    if (fieldCount < 2) {
+        test.testID = NULL;
+        test.testArgs = NULL;
+        return test;
     }
 
     // Number of args is total fields minus 2.
     test.testArgsCount = fieldCount - 2;
 
-    // Allocate memory for the args.
-    test.testArgs = malloc((test.testArgsCount + 1) * sizeof(char *));
-
-    // Copy the args into testArgs array.
-    for (int j = 2; j < fieldCount; j++) {
-        test.testArgs[j - 2] = strdup(fields[j]);
+    // Allocate the args array, followed by the strings it points to.
+    size_t arraySize = (size_t)(fieldCount - 1) * sizeof(char *);
+    test.testArgs = malloc(arraySize + stringsSize);
+    char *strings = (char *)test.testArgs + arraySize;
+
+    // Copy testID, testInputFileName and the args into the allocation.
+    for (int j = 0; j < fieldCount; j++) {
+        size_t length = strlen(fields[j]) + 1;
+        memcpy(strings, fields[j], length);
+        if (j == 0) {
+            test.testID = strings;
+        } else if (j == 1) {
+            test.testInputFileName = strings;
+        } else {
+            test.testArgs[j - 2] = strings;
+        }
+        strings += length;
     } 
 
     // Last element of testArgs array is NULL. 
@@ -446,7 +1038,7 @@ IndividualTest create_new_individual_test(char **fields) {
 add_individual_test():
 ----------------------
 Adds an IndividualTest struct to an arry of IndividualTests 
-in the TestFileList struct.
+in the TestFileList struct. The array doubles in size when it is full.
 
 arg1: test - The IndividualTest struct to add.
 arg2: testList - The TestFileList struct to which the test should be added.
@@ -455,11 +1047,14 @@ Returns: None
 */
 void add_individual_test(IndividualTest test, TestFileList *testList) {
     // Allocate memory for the test array in TestFileList struct.
-    testList->tests = realloc(testList->tests, 
-                              (testList->numTests) * sizeof(IndividualTest));
+    if (testList->numTests == testList->capacity) {
+        testList->capacity = testList->capacity ? testList->capacity * 2 : 64;
+        testList->tests = realloc(testList->tests,
+                testList->capacity * sizeof(IndividualTest));
+    }
 
     // Add IndividualTest to TestFileList struct.
-    testList->tests[testList->numTests - 1] = test;
+    testList->tests[testList->numTests++] = test;
 }
 
 /*
@@ -481,44 +1076,98 @@ void job_specification_file(CommandLineArgs *parameters, TestFileList *testList)
     if ((jobfile = fopen(parameters->jobFile, "r")) == NULL) {
         open_job_file_error(parameters->jobFile); }
     // Initialize testList varibales and variables to used in while loop.
-    testList->numTests = 0; testList->tests = NULL;
-    char *line, **fields = NULL, **testIdArray = NULL;
-    int currentLineNumber = 0, testIdCount = 0;
+    testList->numTests = 0; testList->capacity = 0; testList->tests = NULL;
+    char *line, **fields = NULL;
+    int currentLineNumber = 0;
+    long nextTimeoutMs = 0;
+    StringSet testIds = {calloc(64, sizeof(char *)), 64, 0};
+    StringSet inputFiles = {calloc(64, sizeof(char *)), 64, 0};
 
     //Iterate through the jobspec file until EOF is reached. 
     while ((line = read_line(jobfile)) != NULL) {
         currentLineNumber++;
         if (comment_empty_line_check(line)) {
+            if (line[0] == '#') {
+                long timeoutMs = timeout_directive(parameters->jobFile,
+                        currentLineNumber, line);
+                nextTimeoutMs = timeoutMs ? timeoutMs : nextTimeoutMs;
+            }
             free(line);
             continue; }
-        //Check syntax and if the test ID is already in the array.
+        //Check syntax and if the test ID is already in the set. The sets
+        //keep the test's own copies of its ID and input file name.
         fields = check_syntax_error(parameters->jobFile,
                                     currentLineNumber, line);
+        IndividualTest test = create_new_individual_test(fields);
+        if (test.testID == NULL) {
+            syntax_error(parameters->jobFile, currentLineNumber); }
 
-        if (!check_new_test_id(testIdArray, testIdCount, fields[0])) {
+        if (!check_new_test_id(&testIds, test.testID)) {
             same_test_id_error(parameters->jobFile, currentLineNumber); } 
-            else { //Add testID to array if it is not already in the array.
-            testIdArray = realloc(testIdArray,
-                                  (testIdCount + 1) * sizeof(char *));
-            testIdArray[testIdCount] = strdup(fields[0]);
-            testIdCount++; }
 
         //Check if input file can be opened.
-        input_file_open_check(parameters->jobFile, fields[1],
-                              currentLineNumber);
-        // All checks passed, increment test count
-        testList->numTests++;
-        IndividualTest test = create_new_individual_test(fields);
+        input_file_open_check(parameters->jobFile, test.testInputFileName,
+                              currentLineNumber, &inputFiles);
+        // All checks passed, add the test.
+        test.timeoutMs = nextTimeoutMs;
+        nextTimeoutMs = 0;
         add_individual_test(test, testList);
+        free(fields);
         free(line); }
     //Check if job file is empty. 
     if (testList->numTests == 0) {
         jobspec_file_empty(parameters->jobFile); }
-    free_test_id_array(testIdArray, testIdCount);
+    free(testIds.slots);
+    free(inputFiles.slots);
     fclose(jobfile);
 }
 
 
+/*
+is_in_shard():
+--------------
+Checks whether a test belongs to this process's --shard. A test's shard
+depends only on a hash of its ID, so every process given the same job file
+agrees on the shards and each test is run by exactly one of them.
+
+arg1: parameters - The CommandLineArgs struct with the shard.
+arg2: testId - The ID of the test.
+
+Returns: true if the test is in the shard, or if there is no --shard.
+*/
+bool is_in_shard(CommandLineArgs *parameters, char *testId) {
+    if (parameters->shardCount == 0) {
+        return true;
+    }
+    uint64_t hash = hash_bytes(FNV_OFFSET_BASIS, testId, strlen(testId));
+    return (int)(hash % parameters->shardCount) == parameters->shardIndex - 1;
+}
+
+/*
+select_shard_tests():
+---------------------
+Keeps only the tests in this process's --shard (see is_in_shard()).
+
+arg1: parameters - The CommandLineArgs struct with the shard.
+arg2: testList - The TestFileList struct of the job file's tests.
+
+Returns: None
+Errors: None
+*/
+void select_shard_tests(CommandLineArgs *parameters, TestFileList *testList) {
+    int kept = 0;
+    for (int i = 0; i < testList->numTests; i++) {
+        IndividualTest *test = &testList->tests[i];
+        if (is_in_shard(parameters, test->testID)) {
+            testList->tests[kept++] = *test;
+        } else {
+            free(test->testArgs);
+        }
+    }
+    testList->numTests = kept;
+}
+
+
 /*
 make_test_directory():
 ----------------------
@@ -541,684 +1190,3462 @@ void make_test_directory(char *dir) {
     }
 }
 
+/*
+expected_file_name():
+---------------------
+Builds the name of one of a test's expected output files, or of the
+temporary file it is generated into before being renamed into place.
+
+arg1: name - Buffer of PATH_MAX bytes to hold the file name.
+arg2: dir - The directory where the expected output files are stored.
+arg3: testId - The ID of the test.
+arg4: file - Which expected output file (EXPECTED_STDOUT, etc.).
+arg5: temporary - true for the name of the temporary file.
+
+Returns: None
+Errors: None
+*/
+void expected_file_name(char *name, char *dir, char *testId, int file,
+        bool temporary) {
+    snprintf(name, PATH_MAX, "%s/%s.%s%s", dir, testId,
+            expectedFileSuffixes[file], temporary ? ".tmp" : "");
+}
+
 /*
 create_expected_output_file():
 ------------------------------
-Creates expected output files for each test based on the testID.
-These expected output files will be empty, and will be populated later if 
-required.
+Creates the temporary file that one of a test's expected output files is
+generated into. The file only replaces the real expected output file once
+it is complete (see publish_expected_outputs()), so an interrupted run never
+leaves partly written expected output behind.
 
-arg1: testList - The TestFileList struct containing the tests.
-arg2: dir - The directory where the files should be created.
-arg3: index - The index of the current test in the TestFileList struct.
+arg1: dir - The directory where the files should be created.
+arg2: testId - The ID of the test.
+arg3: file - Which expected output file (EXPECTED_STDOUT, etc.).
 
-Returns: None
-Errors: Exits with exit stats of 11 if any file can't be created or
+Returns: A file descriptor open for writing to the temporary file.
+Errors: Exits with exit status of 11 if the file can't be created or
         opened for writing.
 */
-void create_expected_output_file(TestFileList *testList, char *dir, int index) {
-    // Initialize buffer size for the filenames:
-    int buffer = 100;
-    char stdoutFileName[100], stderrFileName[100], exitFileName[100];
-    
-    // Use snprintf to generate the filenames.
-    snprintf(stdoutFileName, buffer, "%s/%s.stdout", dir, 
-             testList->tests[index].testID);
-    snprintf(stderrFileName, buffer, "%s/%s.stderr", dir, 
-             testList->tests[index].testID);
-    snprintf(exitFileName, buffer, "%s/%s.exitstatus", dir, 
-             testList->tests[index].testID);
-    
-    // Use the filenames to create the output files.
-    // Exit if file creation failed.
-    int stdoutFD = open(stdoutFileName, O_WRONLY | O_CREAT | O_TRUNC, 
-                        S_IRWXU | S_IRGRP);
-    if (stdoutFD == -1) {
+int create_expected_output_file(char *dir, char *testId, int file) {
+    char tempFileName[PATH_MAX], fileName[PATH_MAX];
+    expected_file_name(tempFileName, dir, testId, file, true);
+    int fd = open(tempFileName, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+            S_IRWXU | S_IRGRP);
+    if (fd == -1) {
+        expected_file_name(fileName, dir, testId, file, false);
         fprintf(stderr, 
                 "testuqwordladder: Can't open file \"%s\" for writing\n",
-                stdoutFileName);
+                fileName);
         exit(OPEN_FILE_ERROR);
     }
+    return fd;
+}
 
-    int stderrFD = open(stderrFileName, O_WRONLY | O_CREAT | O_TRUNC, 
-                        S_IRWXU | S_IRGRP);
-    if (stderrFD == -1) {
-        fprintf(stderr, 
-                "testuqwordladder: Can't open file \"%s\" for writing\n",
-                stderrFileName);
-        exit(OPEN_FILE_ERROR);
+/*
+run_test_program():
+-------------------
+Launches a program for a test with posix_spawnp(). File actions in the new
+process open the test's input file as standard input and connect standard
+output and standard error to the given descriptors, so the harness never
+holds the input file open and launch cost doesn't grow with the harness's
+own size.
+
+arg1: test - The test to run the program for.
+arg2: program - The name of the program to run, searched for in PATH.
+arg3: stdoutFD - The descriptor the program's standard output goes to.
+arg4: stderrFD - The descriptor the program's standard error goes to.
+
+Returns: The process ID of the program, or -1 if it could not be started
+         (for example if the exec failed).
+Errors: None
+*/
+pid_t run_test_program(IndividualTest *test, char *program, int stdoutFD,
+        int stderrFD) {
+    //Create the arguments for the command to to execute. 
+    //The total argument size is the number of arguments + 2(accounting for 
+    //the program name and the NULL value at the end of the array).
+    int arraySize = test->testArgsCount + 2;
+    char *arguments[arraySize];
+    arguments[0] = program;
+    for (int k = 1; k < arraySize; k++){
+        arguments[k] = test->testArgs[k - 1]; 
     }
 
-    int exitFD = open(exitFileName, O_WRONLY | O_CREAT | O_TRUNC, 
-                      S_IRWXU | S_IRGRP);
-    if (exitFD == -1) {
-        fprintf(stderr, 
-                "testuqwordladder: Can't open file \"%s\" for writing\n",
-                exitFileName);
-        exit(OPEN_FILE_ERROR);
-    }
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO,
+            test->testInputFileName, O_RDONLY, 0);
+    posix_spawn_file_actions_adddup2(&actions, stdoutFD, STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, stderrFD, STDERR_FILENO);
 
-    // If the files can be opened for writing, then wrap the file descriptor
-    testList->tests[index].goodStandOutFileHandler = fdopen(stdoutFD, "w");
-    testList->tests[index].goodStandErrorFileHandler = fdopen(stderrFD, "w");
-    testList->tests[index].goodExitStatusFileHandler = fdopen(exitFD, "w");
+    pid_t pid;
+    if (posix_spawnp(&pid, program, &actions, NULL, arguments, environ)
+            != 0) {
+        pid = -1;
+    }
+    posix_spawn_file_actions_destroy(&actions);
+    return pid;
 }
 
 /*
 fill_expected_output():
 -----------------------
-Generates expected outputs by calling fork() and executing the good-uqword
-ladder program. This function will fill the files that have already been 
-created by the create_expected_output_file() function.
+Starts the good-uqwordladder program for a test, with its standard output
+and standard error written to the test's temporary expected output files.
 
 arg1: testList - The TestFileList struct containing the tests.
-arg2: index - The index of the current test in the TestFileList struct.
+arg2: dir - The directory where the expected output files are stored.
+arg3: index - The index of the current test in the TestFileList struct.
 
-Returns: None
-Errors: None
+Returns: The process ID of the good-uqwordladder process, or -1 if it
+         could not be started.
+Errors: Exits with exit status of 11 if an expected output file can't be
+        created.
 */
-void fill_expected_output(TestFileList *testList, int index){
-    // Create a variable to hold the process ID when calling fork.
-    #include <sys/types.h>
-
-    pid_t pid;
-    char *programName = "good-uqwordladder";
-    //Remove any existing content in the files.
-    ftruncate(fileno(testList->tests[index].goodStandOutFileHandler), 0);
-    ftruncate(fileno(testList->tests[index].goodStandErrorFileHandler), 0);
-    ftruncate(fileno(testList->tests[index].goodExitStatusFileHandler), 0);
-    // Call fork and allocate fork status to pid.
-    pid = fork();
-
-    // The child process:
-    if (pid == 0) {
-        // Redirec the standard input, standard output, and standard error.
-        dup2(fileno(testList->tests[index].testInputFileHandler), STDIN_FILENO);
-        dup2(fileno(testList->tests[index].goodStandOutFileHandler),
-             STDOUT_FILENO);
-        dup2(fileno(testList->tests[index].goodStandErrorFileHandler),
-             STDERR_FILENO);
-
-        // Create an array to store the program name and the command line arguments.
-        int arraySize = testList->tests[index].testArgsCount + 2;
-        char *arguments[arraySize];
-        arguments[0] = programName;
-        // Copy the command line arguments into the arguments array.
-        for (int j = 1; j < arraySize; j++)
-        {
-            arguments[j] = testList->tests[index].testArgs[j - 1];
-        }
-        // execvp the program with the arguments array:
-        execvp(arguments[0], arguments);
-    }
-    
-    // The parent process:
-    else if (pid > 0) {
-        int status;
-        // Wait for the child process to finish, and get exit status.
-        waitpid(pid, &status, 0);
-        int exit_status = WEXITSTATUS(status);
-        //Write exit status to a file, and store the value in the goodExitStatus variable.
-        fprintf(testList->tests[index].goodExitStatusFileHandler, "%d\n",
-                exit_status);
-        testList->tests[index].goodExitStatus = exit_status; 
-    }
+pid_t fill_expected_output(TestFileList *testList, char *dir, int index){
+    IndividualTest *test = &testList->tests[index];
+    int stdoutFD = create_expected_output_file(dir, test->testID,
+            EXPECTED_STDOUT);
+    int stderrFD = create_expected_output_file(dir, test->testID,
+            EXPECTED_STDERR);
+    pid_t pid = run_test_program(test, "good-uqwordladder", stdoutFD,
+            stderrFD);
+    close(stdoutFD);
+    close(stderrFD);
+    return pid;
 }
 
-
 /*
-is_regen_needed():
-------------------
-Checks if regeneration of test files is needed for a particular test. 
+write_all():
+------------
+Writes the whole of a buffer to a file descriptor, carrying on after short
+writes and interrupted calls.
 
-arg1: regen - Flag indicating if regeneration is needed.
-arg2: jobFilePath - The path to the job file.
-arg3: testList - The TestFileList struct containing the tests.
-arg4: index - The index of the current test in the TestFileList struct.
+arg1: fd - The file descriptor to write to.
+arg2: data - The bytes to write.
+arg3: size - The number of bytes.
+
+Returns: true if every byte was written, otherwise false.
+*/
+bool write_all(int fd, const char *data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written == -1 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+/*
+expected_output_write_error():
+------------------------------
+Removes the temporary file of an expected output that couldn't be written
+or renamed into place, reports it and exits.
+
+arg1: dir - The directory where the expected output files are stored.
+arg2: testId - The ID of the test.
+arg3: file - Which expected output file (EXPECTED_STDOUT, etc.).
+
+Returns: Doesn't return.
+Errors: Exits with exit status of 11.
+*/
+void expected_output_write_error(char *dir, char *testId, int file) {
+    char fileName[PATH_MAX];
+    expected_file_name(fileName, dir, testId, file, true);
+    unlink(fileName);
+    expected_file_name(fileName, dir, testId, file, false);
+    fprintf(stderr, "testuqwordladder: Can't write file \"%s\"\n", fileName);
+    exit(OPEN_FILE_ERROR);
+}
+
+/*
+copy_expected_output_file():
+----------------------------
+Copies a generated temporary expected output file to the temporary file of
+another test that has the same arguments and input file.
+
+arg1: dir - The directory where the expected output files are stored.
+arg2: fromId - The ID of the test the output was generated for.
+arg3: toId - The ID of the test to copy the output to.
+arg4: file - Which expected output file (EXPECTED_STDOUT, etc.).
+
+Returns: None
+Errors: Exits with exit status of 11 if the file can't be created or
+        written in full.
+*/
+void copy_expected_output_file(char *dir, char *fromId, char *toId,
+        int file) {
+    char fromFileName[PATH_MAX], chunk[READ_CHUNK_SIZE];
+    expected_file_name(fromFileName, dir, fromId, file, true);
+    int fromFD = open(fromFileName, O_RDONLY | O_CLOEXEC);
+    int toFD = create_expected_output_file(dir, toId, file);
+    ssize_t bytes = 0;
+    bool written = true;
+    while (fromFD != -1 && written
+            && (bytes = read(fromFD, chunk, sizeof(chunk))) > 0) {
+        written = write_all(toFD, chunk, bytes);
+    }
+    if (fromFD != -1) {
+        close(fromFD);
+    }
+    if (close(toFD) != 0 || !written || bytes == -1) {
+        expected_output_write_error(dir, toId, file);
+    }
+}
+
+/*
+publish_expected_outputs():
+---------------------------
+Records the exit status of a finished good-uqwordladder run and renames the
+temporary expected output files into place for every test that shares the
+run. The first test in the group is the one the run was generated for.
+
+arg1: testList - The TestFileList struct containing the tests.
+arg2: dir - The directory where the expected output files are stored.
+arg3: group - Indexes of the tests sharing the run.
+arg4: groupSize - The number of tests sharing the run.
+arg5: status - The wait status of the good-uqwordladder run.
+
+Returns: None
+Errors: Exits with exit status of 11 if a file can't be created, written or
+        renamed into place, before the manifest can record it as fresh.
+*/
+void publish_expected_outputs(TestFileList *testList, char *dir, int *group,
+        int groupSize, int status) {
+    char *leaderId = testList->tests[group[0]].testID;
+    int exitStatus = WEXITSTATUS(status);
+    int exitFD = create_expected_output_file(dir, leaderId,
+            EXPECTED_EXIT_STATUS);
+    FILE *exitFile = fdopen(exitFD, "w");
+    if (exitFile == NULL) {
+        close(exitFD);
+        expected_output_write_error(dir, leaderId, EXPECTED_EXIT_STATUS);
+    }
+    bool written = fprintf(exitFile, "%d\n", exitStatus) > 0;
+    if (fclose(exitFile) != 0 || !written) {
+        expected_output_write_error(dir, leaderId, EXPECTED_EXIT_STATUS);
+    }
+
+    // Copy the leader's files before they are renamed away.
+    for (int i = groupSize - 1; i >= 0; i--) {
+        IndividualTest *test = &testList->tests[group[i]];
+        for (int file = 0; file < NUM_EXPECTED_FILES; file++) {
+            char tempFileName[PATH_MAX], fileName[PATH_MAX];
+            if (i > 0) {
+                copy_expected_output_file(dir, leaderId, test->testID, file);
+            }
+            expected_file_name(tempFileName, dir, test->testID, file, true);
+            expected_file_name(fileName, dir, test->testID, file, false);
+            if (rename(tempFileName, fileName) != 0) {
+                expected_output_write_error(dir, test->testID, file);
+            }
+        }
+        test->goodExitStatus = exitStatus;
+    }
+}
+
+/*
+hash_file():
+------------
+Adds the contents of a file to a 64-bit FNV-1a hash.
+
+arg1: hash - The hash so far.
+arg2: fileName - The file to hash.
+
+Returns: The updated hash. A file that can't be read hashes as empty.
+*/
+uint64_t hash_file(uint64_t hash, char *fileName) {
+    char chunk[READ_CHUNK_SIZE];
+    ssize_t bytes;
+    int fd = open(fileName, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return hash;
+    }
+    while ((bytes = read(fd, chunk, sizeof(chunk))) > 0) {
+        hash = hash_bytes(hash, chunk, bytes);
+    }
+    close(fd);
+    return hash;
+}
+
+/*
+reference_program_hash():
+-------------------------
+Hashes the good-uqwordladder binary that execvp() would run, found by
+searching PATH.
+
+Returns: The hash of the binary, or the empty hash if it can't be found.
+*/
+uint64_t reference_program_hash(void) {
+    char *path = getenv("PATH");
+    char fileName[PATH_MAX];
+    while (path != NULL && *path != '\0') {
+        size_t length = strcspn(path, ":");
+        snprintf(fileName, PATH_MAX, "%.*s/good-uqwordladder", (int)length,
+                path);
+        if (access(fileName, X_OK) == 0) {
+            return hash_file(FNV_OFFSET_BASIS, fileName);
+        }
+        path += length + (path[length] == ':');
+    }
+    return FNV_OFFSET_BASIS;
+}
+
+/*
+test_expected_hash():
+---------------------
+Hashes everything a test's expected outputs are generated from: its
+arguments, the contents of its input file and the good-uqwordladder binary.
+
+arg1: test - The test to hash.
+arg2: programHash - The hash of the good-uqwordladder binary.
+
+Returns: The test's hash.
+*/
+uint64_t test_expected_hash(IndividualTest *test, uint64_t programHash) {
+    uint64_t hash = hash_bytes(FNV_OFFSET_BASIS, &programHash,
+            sizeof(programHash));
+    for (int i = 0; i < test->testArgsCount; i++) {
+        // Include the terminator so "ab" "c" and "a" "bc" differ.
+        hash = hash_bytes(hash, test->testArgs[i],
+                strlen(test->testArgs[i]) + 1);
+    }
+    hash = hash_bytes(hash, &test->testArgsCount,
+            sizeof(test->testArgsCount));
+    return hash_file(hash, test->testInputFileName);
+}
+
+/*
+compare_manifest_entries():
+---------------------------
+qsort() and bsearch() comparison function for ManifestEntry structs, by test
+ID.
+*/
+int compare_manifest_entries(const void *a, const void *b) {
+    return strcmp(((const ManifestEntry *)a)->testId,
+            ((const ManifestEntry *)b)->testId);
+}
+
+/*
+read_manifest():
+----------------
+Reads the manifest in the expected output directory. Each line holds a test
+ID and the hash its expected outputs were generated from, separated by a
+tab. A missing manifest, or malformed lines, are treated as no entries so
+the affected tests are regenerated.
+
+arg1: dir - The directory where the expected output files are stored.
+arg2: manifest - The Manifest struct to fill in.
+
+Returns: None
+Errors: None
+*/
+void read_manifest(char *dir, Manifest *manifest) {
+    char fileName[PATH_MAX];
+    char *line;
+    snprintf(fileName, PATH_MAX, "%s/%s", dir, MANIFEST_FILE_NAME);
+    manifest->entries = NULL;
+    manifest->numEntries = 0;
+    FILE *manifestFile = fopen(fileName, "r");
+    if (manifestFile == NULL) {
+        return;
+    }
+    int capacity = 0;
+    while ((line = read_line(manifestFile)) != NULL) {
+        char *tab = strrchr(line, '\t');
+        char *end;
+        if (tab != NULL) {
+            *tab = '\0';
+            uint64_t hash = strtoull(tab + 1, &end, 16);
+            if (*end == '\0' && end != tab + 1) {
+                if (manifest->numEntries == capacity) {
+                    capacity = capacity ? capacity * 2 : 64;
+                    manifest->entries = realloc(manifest->entries,
+                            capacity * sizeof(ManifestEntry));
+                }
+                manifest->entries[manifest->numEntries].testId = strdup(line);
+                manifest->entries[manifest->numEntries++].expectedHash = hash;
+            }
+        }
+        free(line);
+    }
+    fclose(manifestFile);
+    qsort(manifest->entries, manifest->numEntries, sizeof(ManifestEntry),
+            compare_manifest_entries);
+}
+
+/*
+write_manifest():
+-----------------
+Writes the manifest for the tests in the job file, replacing the old one
+atomically. With --shard, the old entries of tests in other shards are kept,
+so running the shards one after another doesn't regenerate every test.
+
+arg1: parameters - The CommandLineArgs struct with the directory where the
+      expected output files are stored and the shard.
+arg2: testList - The TestFileList struct containing the tests.
+arg3: manifest - The manifest read before the tests were regenerated.
+
+Returns: None
+Errors: Exits with exit status of 11 if the manifest can't be created.
+*/
+void write_manifest(CommandLineArgs *parameters, TestFileList *testList,
+        Manifest *manifest) {
+    char *dir = parameters->dir;
+    char fileName[PATH_MAX], tempFileName[PATH_MAX];
+    snprintf(fileName, PATH_MAX, "%s/%s", dir, MANIFEST_FILE_NAME);
+    snprintf(tempFileName, PATH_MAX, "%s/%s.tmp", dir, MANIFEST_FILE_NAME);
+    FILE *manifestFile = fopen(tempFileName, "w");
+    if (manifestFile == NULL) {
+        fprintf(stderr,
+                "testuqwordladder: Can't open file \"%s\" for writing\n",
+                fileName);
+        exit(OPEN_FILE_ERROR);
+    }
+    for (int i = 0; i < testList->numTests; i++) {
+        fprintf(manifestFile, "%s\t%016" PRIx64 "\n",
+                testList->tests[i].testID, testList->tests[i].expectedHash);
+    }
+    for (int i = 0; i < manifest->numEntries; i++) {
+        ManifestEntry *entry = &manifest->entries[i];
+        if (!is_in_shard(parameters, entry->testId)) {
+            fprintf(manifestFile, "%s\t%016" PRIx64 "\n", entry->testId,
+                    entry->expectedHash);
+        }
+    }
+    fclose(manifestFile);
+    rename(tempFileName, fileName);
+}
+
+/*
+free_manifest():
+----------------
+Frees the entries read by read_manifest().
+
+arg1: manifest - The manifest to free.
+*/
+void free_manifest(Manifest *manifest) {
+    for (int i = 0; i < manifest->numEntries; i++) {
+        free(manifest->entries[i].testId);
+    }
+    free(manifest->entries);
+}
+
+/*
+is_regen_needed():
+------------------
+Checks if regeneration of test files is needed for a particular test. This
+is the case if any of its expected output files are missing, or if the hash
+of its arguments, input file and good-uqwordladder binary differs from the
+one recorded in the manifest when the files were generated.
+
+arg1: regen - Flag indicating if regeneration is needed.
+arg2: dir - The directory where the expected output files are stored.
+arg3: test - The test to check.
+arg4: manifest - The manifest read from dir.
 
 Returns: True if regeneration is needed, otherwise False.
 Errors: None
 */
-bool is_regen_needed(bool regen, char *jobFilePath, TestFileList *testList,
-                     int index) {
+bool is_regen_needed(bool regen, char *dir, IndividualTest *test,
+        Manifest *manifest) {
     if (regen) {
         return true;
     }
-    struct stat jobFileStat, stdoutFileStat, stderrFileStat, exitFileStat;
-    stat(jobFilePath, &jobFileStat);
-    int goodStandOut = fstat(
-        fileno(testList->tests[index].goodStandOutFileHandler),
-        &stdoutFileStat);
-    int goodStandError = fstat(
-        fileno(testList->tests[index].goodStandErrorFileHandler),
-        &stderrFileStat);
-    int goodExitStatus = fstat(
-        fileno(testList->tests[index].goodExitStatusFileHandler),
-        &exitFileStat);
-
-    if (goodStandOut == -1 || goodStandError == -1 || goodExitStatus == -1) {
+    ManifestEntry key = {.testId = test->testID};
+    ManifestEntry *entry = bsearch(&key, manifest->entries,
+            manifest->numEntries, sizeof(ManifestEntry),
+            compare_manifest_entries);
+    if (entry == NULL || entry->expectedHash != test->expectedHash) {
         return true;
     }
+    struct stat expectedFileStat;
+    for (int file = 0; file < NUM_EXPECTED_FILES; file++) {
+        char fileName[PATH_MAX];
+        expected_file_name(fileName, dir, test->testID, file, false);
+        if (stat(fileName, &expectedFileStat) == -1) {
+            return true;
+        }
+    }
+    return false;
+}
 
-    if (compare_timespecs(jobFileStat.st_mtim, stdoutFileStat.st_mtim) > 0) {
-        return true;
+/*
+read_expected_exit_status():
+----------------------------
+Reads a test's expected exit status from its .exitstatus file.
+
+arg1: dir - The directory where the expected output files are stored.
+arg2: testId - The ID of the test.
+
+Returns: The expected exit status, or -1 if it can't be read.
+Errors: None
+*/
+int read_expected_exit_status(char *dir, char *testId) {
+    char fileName[PATH_MAX];
+    int exitStatus = -1;
+    expected_file_name(fileName, dir, testId, EXPECTED_EXIT_STATUS, false);
+    FILE *exitFile = fopen(fileName, "r");
+    if (exitFile != NULL) {
+        if (fscanf(exitFile, "%d", &exitStatus) != 1) {
+            exitStatus = -1;
+        }
+        fclose(exitFile);
     }
-    if (compare_timespecs(jobFileStat.st_mtim, stderrFileStat.st_mtim) > 0) {
-        return true;
+    return exitStatus;
+}
+
+/*
+compare_test_invocations():
+---------------------------
+qsort_r() comparison function that orders test indexes by input file name
+and then by arguments, so tests that would run good-uqwordladder in exactly
+the same way end up next to each other.
+
+arg1: a - Pointer to the first test index.
+arg2: b - Pointer to the second test index.
+arg3: context - The TestFileList struct containing the tests.
+
+Returns: Negative, zero or positive as for strcmp().
+*/
+int compare_test_invocations(const void *a, const void *b, void *context) {
+    TestFileList *testList = context;
+    IndividualTest *testA = &testList->tests[*(const int *)a];
+    IndividualTest *testB = &testList->tests[*(const int *)b];
+    int result = strcmp(testA->testInputFileName, testB->testInputFileName);
+    for (int i = 0; result == 0; i++) {
+        if (testA->testArgs[i] == NULL || testB->testArgs[i] == NULL) {
+            return (testA->testArgs[i] != NULL) - (testB->testArgs[i] != NULL);
+        }
+        result = strcmp(testA->testArgs[i], testB->testArgs[i]);
+    }
+    return result;
+}
+
+/*
+pack_blob_slot():
+-----------------
+Finds the slot of a blob in the pack store's blob table.
+
+arg1: store - The pack store.
+arg2: contentHash - The hash of the blob's contents.
+arg3: length - The length of the blob.
+
+Returns: The slot holding the blob, or the empty slot where it belongs.
+*/
+PackBlob *pack_blob_slot(PackStore *store, uint64_t contentHash,
+        uint64_t length) {
+    size_t mask = store->blobCapacity - 1;
+    size_t slot = contentHash & mask;
+    while (store->blobs[slot].length != 0
+            && (store->blobs[slot].contentHash != contentHash
+            || store->blobs[slot].length != length)) {
+        slot = (slot + 1) & mask;
+    }
+    return &store->blobs[slot];
+}
+
+/*
+add_pack_blob():
+----------------
+Records a blob that is in the pack file, doubling the blob table once it is
+half full. Blobs already recorded are ignored.
+
+arg1: store - The pack store.
+arg2: blob - The blob to record.
+
+Returns: None
+*/
+void add_pack_blob(PackStore *store, PackBlob blob) {
+    if (blob.length == 0) {
+        return;
+    }
+    if ((store->numBlobs + 1) * 2 > store->blobCapacity) {
+        PackStore grown = *store;
+        grown.blobCapacity = store->blobCapacity * 2;
+        grown.blobs = calloc(grown.blobCapacity, sizeof(PackBlob));
+        for (size_t i = 0; i < store->blobCapacity; i++) {
+            if (store->blobs[i].length != 0) {
+                *pack_blob_slot(&grown, store->blobs[i].contentHash,
+                        store->blobs[i].length) = store->blobs[i];
+            }
+        }
+        free(store->blobs);
+        *store = grown;
+    }
+    PackBlob *slot = pack_blob_slot(store, blob.contentHash, blob.length);
+    if (slot->length == 0) {
+        *slot = blob;
+        store->numBlobs++;
+    }
+}
+
+/*
+compare_pack_entries():
+-----------------------
+qsort() and bsearch() comparison function for PackEntry structs, by test ID.
+*/
+int compare_pack_entries(const void *a, const void *b) {
+    return strcmp(((const PackEntry *)a)->testId,
+            ((const PackEntry *)b)->testId);
+}
+
+/*
+parse_pack_entry():
+-------------------
+Parses a line of the pack index: the test ID, the hash its expected outputs
+were generated from, the expected exit status, then the offset, length and
+content hash of the expected stdout and of the expected stderr, separated
+by tabs. Hashes are in hexadecimal.
+
+arg1: line - The line to parse. It is split in place.
+arg2: packSize - The size of the pack file.
+arg3: entry - The PackEntry to fill in. Its testId points into line.
+
+Returns: true if the line is valid, otherwise false.
+*/
+bool parse_pack_entry(char *line, uint64_t packSize, PackEntry *entry) {
+    char **fields = split_string(line, '\t');
+    char *end;
+    bool valid = true;
+    int numFields = 0;
+    while (fields[numFields] != NULL) {
+        numFields++;
+    }
+    if (numFields != 3 + 3 * NUM_OUTPUT_STREAMS) {
+        free(fields);
+        return false;
+    }
+    entry->testId = fields[0];
+    entry->expectedHash = strtoull(fields[1], &end, 16);
+    valid = valid && *end == '\0';
+    entry->exitStatus = strtol(fields[2], &end, 10);
+    valid = valid && *end == '\0';
+    for (int i = 0; i < NUM_OUTPUT_STREAMS; i++) {
+        entry->offset[i] = strtoull(fields[3 + 3 * i], &end, 10);
+        valid = valid && *end == '\0';
+        entry->length[i] = strtoull(fields[4 + 3 * i], &end, 10);
+        valid = valid && *end == '\0';
+        entry->contentHash[i] = strtoull(fields[5 + 3 * i], &end, 16);
+        valid = valid && *end == '\0'
+                && entry->offset[i] + entry->length[i] <= packSize;
+    }
+    free(fields);
+    return valid;
+}
+
+/*
+open_pack_store():
+------------------
+Opens the pack file in the expected output directory for appending, creating
+it if needed, and reads the pack index. Every blob the index refers to is
+added to the blob table so that identical outputs are stored only once.
+
+arg1: dir - The directory where the expected output files are stored.
+arg2: store - The PackStore struct to set up.
+
+Returns: None
+Errors: Exits with exit status of 11 if the pack file can't be opened for
+        writing.
+*/
+void open_pack_store(char *dir, PackStore *store) {
+    char fileName[PATH_MAX];
+    struct stat packStat;
+    char *line;
+    snprintf(fileName, PATH_MAX, "%s/%s", dir, PACK_FILE_NAME);
+    store->fd = open(fileName, O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC,
+            S_IRWXU | S_IRGRP);
+    if (store->fd == -1) {
+        fprintf(stderr,
+                "testuqwordladder: Can't open file \"%s\" for writing\n",
+                fileName);
+        exit(OPEN_FILE_ERROR);
+    }
+    fstat(store->fd, &packStat);
+    store->size = packStat.st_size;
+    store->blobCapacity = 64;
+    store->blobs = calloc(store->blobCapacity, sizeof(PackBlob));
+    store->numBlobs = 0;
+    store->entries = NULL;
+    store->numEntries = 0;
+
+    snprintf(fileName, PATH_MAX, "%s/%s", dir, PACK_INDEX_FILE_NAME);
+    FILE *indexFile = fopen(fileName, "r");
+    int capacity = 0;
+    while (indexFile != NULL && (line = read_line(indexFile)) != NULL) {
+        PackEntry entry;
+        if (parse_pack_entry(line, store->size, &entry)) {
+            entry.testId = strdup(entry.testId);
+            if (store->numEntries == capacity) {
+                capacity = capacity ? capacity * 2 : 64;
+                store->entries = realloc(store->entries,
+                        capacity * sizeof(PackEntry));
+            }
+            store->entries[store->numEntries++] = entry;
+            for (int i = 0; i < NUM_OUTPUT_STREAMS; i++) {
+                add_pack_blob(store, (PackBlob){entry.contentHash[i],
+                        entry.offset[i], entry.length[i]});
+            }
+        }
+        free(line);
+    }
+    if (indexFile != NULL) {
+        fclose(indexFile);
+    }
+    qsort(store->entries, store->numEntries, sizeof(PackEntry),
+            compare_pack_entries);
+}
+
+/*
+find_pack_entry():
+------------------
+Looks up a test in the pack index read by open_pack_store().
+
+arg1: store - The pack store.
+arg2: testId - The ID of the test.
+
+Returns: The test's entry, or NULL if it has none.
+*/
+PackEntry *find_pack_entry(PackStore *store, char *testId) {
+    PackEntry key = {.testId = testId};
+    return bsearch(&key, store->entries, store->numEntries, sizeof(PackEntry),
+            compare_pack_entries);
+}
+
+/*
+pack_expected_file():
+---------------------
+Moves a generated temporary expected output file into the pack file. If an
+output with the same contents is already in the pack, that copy is used
+instead of appending another.
+
+arg1: store - The pack store.
+arg2: dir - The directory where the expected output files are stored.
+arg3: testId - The ID of the test the output was generated for.
+arg4: file - Which expected output file (EXPECTED_STDOUT or EXPECTED_STDERR).
+
+Returns: Where the output is in the pack file.
+Errors: Exits with exit status of 11 if the output can't be written to the
+        pack file in full.
+*/
+PackBlob pack_expected_file(PackStore *store, char *dir, char *testId,
+        int file) {
+    char tempFileName[PATH_MAX];
+    struct stat tempStat;
+    PackBlob blob = {FNV_OFFSET_BASIS, 0, 0};
+    expected_file_name(tempFileName, dir, testId, file, true);
+    int fd = open(tempFileName, O_RDONLY | O_CLOEXEC);
+    if (fd != -1 && fstat(fd, &tempStat) == 0 && tempStat.st_size > 0) {
+        char *data = mmap(NULL, tempStat.st_size, PROT_READ, MAP_PRIVATE, fd,
+                0);
+        if (data != MAP_FAILED) {
+            blob.length = tempStat.st_size;
+            blob.contentHash = hash_bytes(FNV_OFFSET_BASIS, data, blob.length);
+            PackBlob *existing = pack_blob_slot(store, blob.contentHash,
+                    blob.length);
+            if (existing->length != 0) {
+                blob = *existing;
+            } else {
+                blob.offset = store->size;
+                if (!write_all(store->fd, data, blob.length)) {
+                    // Drop whatever part of the output made it into the pack.
+                    ftruncate(store->fd, store->size);
+                    fprintf(stderr,
+                            "testuqwordladder: Can't write file \"%s/%s\"\n",
+                            dir, PACK_FILE_NAME);
+                    exit(OPEN_FILE_ERROR);
+                }
+                store->size += blob.length;
+                add_pack_blob(store, blob);
+            }
+            munmap(data, tempStat.st_size);
+        }
+    }
+    if (fd != -1) {
+        close(fd);
+    }
+    unlink(tempFileName);
+    return blob;
+}
+
+/*
+pack_expected_outputs():
+------------------------
+The --pack counterpart of publish_expected_outputs(): moves the outputs of a
+finished good-uqwordladder run into the pack file and records where they
+are for every test that shares the run.
+
+arg1: testList - The TestFileList struct containing the tests.
+arg2: store - The pack store.
+arg3: dir - The directory where the expected output files are stored.
+arg4: group - Indexes of the tests sharing the run.
+arg5: groupSize - The number of tests sharing the run.
+arg6: status - The wait status of the good-uqwordladder run.
+
+Returns: None
+Errors: None
+*/
+void pack_expected_outputs(TestFileList *testList, PackStore *store,
+        char *dir, int *group, int groupSize, int status) {
+    PackBlob blobs[NUM_OUTPUT_STREAMS];
+    char *leaderId = testList->tests[group[0]].testID;
+    blobs[STDOUT_STREAM] = pack_expected_file(store, dir, leaderId,
+            EXPECTED_STDOUT);
+    blobs[STDERR_STREAM] = pack_expected_file(store, dir, leaderId,
+            EXPECTED_STDERR);
+    for (int i = 0; i < groupSize; i++) {
+        IndividualTest *test = &testList->tests[group[i]];
+        for (int j = 0; j < NUM_OUTPUT_STREAMS; j++) {
+            test->packOffset[j] = blobs[j].offset;
+            test->packLength[j] = blobs[j].length;
+            test->contentHash[j] = blobs[j].contentHash;
+        }
+        test->goodExitStatus = WEXITSTATUS(status);
+    }
+}
+
+/*
+compact_pack_file():
+--------------------
+Outputs are only ever appended to the pack file, so the outputs of tests
+that were removed or regenerated stay in it. Once the outputs the new index
+refers to take up less than half of the pack file, this copies just those
+into a new pack file and moves the entries' offsets to match. The old index
+is removed before the new pack file replaces the old one, so if the run is
+interrupted the next run regenerates the outputs instead of reading them
+from the wrong place. If the new pack file can't be written the old one is
+kept as it is.
+
+arg1: store - The pack store.
+arg2: dir - The directory where the expected output files are stored.
+arg3: entries - The entries of the index about to be written.
+arg4: numEntries - The number of entries.
+
+Returns: None
+Errors: None
+*/
+void compact_pack_file(PackStore *store, char *dir, PackEntry *entries,
+        int numEntries) {
+    char fileName[PATH_MAX], tempFileName[PATH_MAX];
+    PackStore live = {.blobCapacity = 64, .numBlobs = 0};
+    live.blobs = calloc(live.blobCapacity, sizeof(PackBlob));
+    uint64_t liveSize = 0;
+    for (int i = 0; i < numEntries; i++) {
+        for (int j = 0; j < NUM_OUTPUT_STREAMS; j++) {
+            if (entries[i].length[j] != 0 && pack_blob_slot(&live,
+                    entries[i].contentHash[j], entries[i].length[j])->length
+                    == 0) {
+                add_pack_blob(&live, (PackBlob){entries[i].contentHash[j],
+                        liveSize, entries[i].length[j]});
+                liveSize += entries[i].length[j];
+            }
+        }
+    }
+    char *pack = liveSize * 2 < store->size ? mmap(NULL, store->size,
+            PROT_READ, MAP_PRIVATE, store->fd, 0) : MAP_FAILED;
+    if (pack == MAP_FAILED) {
+        free(live.blobs);
+        return;
+    }
+
+    // Blobs were given their new offsets in the order they are copied here.
+    snprintf(fileName, PATH_MAX, "%s/%s", dir, PACK_FILE_NAME);
+    snprintf(tempFileName, PATH_MAX, "%s/%s.tmp", dir, PACK_FILE_NAME);
+    int fd = open(tempFileName, O_RDWR | O_APPEND | O_CREAT | O_TRUNC
+            | O_CLOEXEC, S_IRWXU | S_IRGRP);
+    uint64_t copied = 0;
+    for (int i = 0; fd != -1 && i < numEntries; i++) {
+        for (int j = 0; fd != -1 && j < NUM_OUTPUT_STREAMS; j++) {
+            PackBlob *blob = pack_blob_slot(&live, entries[i].contentHash[j],
+                    entries[i].length[j]);
+            if (entries[i].length[j] == 0 || blob->offset != copied) {
+                continue;
+            }
+            if (!write_all(fd, pack + entries[i].offset[j], blob->length)) {
+                close(fd);
+                fd = -1;
+            }
+            copied += blob->length;
+        }
+    }
+    munmap(pack, store->size);
+    snprintf(fileName, PATH_MAX, "%s/%s", dir, PACK_INDEX_FILE_NAME);
+    if (fd != -1) {
+        unlink(fileName);
+        snprintf(fileName, PATH_MAX, "%s/%s", dir, PACK_FILE_NAME);
+        if (rename(tempFileName, fileName) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    if (fd == -1) {
+        unlink(tempFileName);
+        free(live.blobs);
+        return;
+    }
+
+    close(store->fd);
+    store->fd = fd;
+    store->size = liveSize;
+    for (int i = 0; i < numEntries; i++) {
+        for (int j = 0; j < NUM_OUTPUT_STREAMS; j++) {
+            if (entries[i].length[j] != 0) {
+                entries[i].offset[j] = pack_blob_slot(&live,
+                        entries[i].contentHash[j],
+                        entries[i].length[j])->offset;
+            }
+        }
+    }
+    free(live.blobs);
+}
+
+/*
+close_pack_store():
+-------------------
+Writes the pack index for the tests in the job file, replacing the old one
+atomically, then maps the pack file for comparing outputs. With --shard, the
+old entries of tests in other shards are kept. The pack file is
+only appended to during a run, so an interrupted run leaves at worst some
+bytes no index line refers to; compact_pack_file() reclaims them once they
+make up most of the file.
+
+arg1: store - The pack store.
+arg2: parameters - The CommandLineArgs struct with the directory where the
+      expected output files are stored and the shard.
+arg3: testList - The TestFileList struct containing the tests.
+
+Returns: None
+Errors: Exits with exit status of 11 if the index can't be written.
+*/
+void close_pack_store(PackStore *store, CommandLineArgs *parameters,
+        TestFileList *testList) {
+    char fileName[PATH_MAX], tempFileName[PATH_MAX];
+    char *dir = parameters->dir;
+    int numEntries = testList->numTests;
+    PackEntry *entries = malloc((testList->numTests + store->numEntries + 1)
+            * sizeof(PackEntry));
+    for (int i = 0; i < testList->numTests; i++) {
+        IndividualTest *test = &testList->tests[i];
+        entries[i].testId = test->testID;
+        entries[i].expectedHash = test->expectedHash;
+        entries[i].exitStatus = test->goodExitStatus;
+        for (int j = 0; j < NUM_OUTPUT_STREAMS; j++) {
+            entries[i].offset[j] = test->packOffset[j];
+            entries[i].length[j] = test->packLength[j];
+            entries[i].contentHash[j] = test->contentHash[j];
+        }
+    }
+    for (int i = 0; i < store->numEntries; i++) {
+        if (!is_in_shard(parameters, store->entries[i].testId)) {
+            entries[numEntries++] = store->entries[i];
+        }
+    }
+    compact_pack_file(store, dir, entries, numEntries);
+
+    snprintf(fileName, PATH_MAX, "%s/%s", dir, PACK_INDEX_FILE_NAME);
+    snprintf(tempFileName, PATH_MAX, "%s/%s.tmp", dir, PACK_INDEX_FILE_NAME);
+    FILE *indexFile = fopen(tempFileName, "w");
+    if (indexFile == NULL) {
+        fprintf(stderr,
+                "testuqwordladder: Can't open file \"%s\" for writing\n",
+                fileName);
+        exit(OPEN_FILE_ERROR);
+    }
+    for (int i = 0; i < numEntries; i++) {
+        PackEntry *entry = &entries[i];
+        fprintf(indexFile, "%s\t%016" PRIx64 "\t%d", entry->testId,
+                entry->expectedHash, entry->exitStatus);
+        for (int j = 0; j < NUM_OUTPUT_STREAMS; j++) {
+            fprintf(indexFile, "\t%" PRIu64 "\t%" PRIu64 "\t%016" PRIx64,
+                    entry->offset[j], entry->length[j],
+                    entry->contentHash[j]);
+            if (i < testList->numTests) {
+                testList->tests[i].packOffset[j] = entry->offset[j];
+            }
+        }
+        fputc('\n', indexFile);
+    }
+    free(entries);
+    if (fclose(indexFile) != 0 || rename(tempFileName, fileName) != 0) {
+        unlink(tempFileName);
+        fprintf(stderr, "testuqwordladder: Can't write file \"%s\"\n",
+                fileName);
+        exit(OPEN_FILE_ERROR);
+    }
+
+    testList->packSize = store->size;
+    if (store->size > 0) {
+        testList->pack = mmap(NULL, store->size, PROT_READ, MAP_PRIVATE,
+                store->fd, 0);
+        if (testList->pack == MAP_FAILED) {
+            snprintf(fileName, PATH_MAX, "%s/%s", dir, PACK_FILE_NAME);
+            fprintf(stderr, "testuqwordladder: Can't map file \"%s\"\n",
+                    fileName);
+            exit(OPEN_FILE_ERROR);
+        }
+    }
+    close(store->fd);
+    for (int i = 0; i < store->numEntries; i++) {
+        free(store->entries[i].testId);
+    }
+    free(store->entries);
+    free(store->blobs);
+}
+
+/*
+is_packed_test_fresh():
+-----------------------
+With --pack, checks whether a test's outputs in the pack are up to date,
+and if so takes their location and the expected exit status from the index.
+
+arg1: regen - Flag indicating if regeneration is needed.
+arg2: store - The pack store.
+arg3: test - The test to check.
+
+Returns: true if the test doesn't need regenerating, otherwise false.
+*/
+bool is_packed_test_fresh(bool regen, PackStore *store, IndividualTest *test) {
+    PackEntry *entry = find_pack_entry(store, test->testID);
+    if (regen || entry == NULL || entry->expectedHash != test->expectedHash) {
+        return false;
+    }
+    for (int i = 0; i < NUM_OUTPUT_STREAMS; i++) {
+        test->packOffset[i] = entry->offset[i];
+        test->packLength[i] = entry->length[i];
+        test->contentHash[i] = entry->contentHash[i];
+    }
+    test->goodExitStatus = entry->exitStatus;
+    return true;
+}
+
+/*
+record_expected_outputs():
+--------------------------
+Stores the outputs of a finished good-uqwordladder run, in the pack file
+with --pack and as separate files otherwise.
+
+arg1: testList - The TestFileList struct containing the tests.
+arg2: store - The pack store, or NULL without --pack.
+arg3: dir - The directory where the expected output files are stored.
+arg4: group - Indexes of the tests sharing the run.
+arg5: groupSize - The number of tests sharing the run.
+arg6: status - The wait status of the good-uqwordladder run.
+*/
+void record_expected_outputs(TestFileList *testList, PackStore *store,
+        char *dir, int *group, int groupSize, int status) {
+    if (store != NULL) {
+        pack_expected_outputs(testList, store, dir, group, groupSize, status);
+    } else {
+        publish_expected_outputs(testList, dir, group, groupSize, status);
+    }
+}
+
+/*
+generating_expected_outputs():
+-----------------------------
+Makes sure every test in the TestFileList struct has up to date expected
+output files, as recorded in the manifest (see is_regen_needed()). Tests
+whose files are current just have their expected exit status read back. The rest are grouped by input file and arguments so that
+good-uqwordladder is run only once per distinct invocation, and up to --jobs
+of those runs happen at once. Each run's output is shared with every test in
+its group.
+
+arg1: parameters - The CommandLineArgs struct containing command line 
+arguments such as the directory name to  store the expected output files.
+arg2: testList - The TestFileList struct containing the tests to generate expected output for.
+
+Returns: None
+Errors: Exits with exit status of 11 if an expected output file can't be
+        created.
+*/
+
+void generating_expected_outputs(CommandLineArgs *parameters,
+                                 TestFileList *testList) {
+    make_test_directory(parameters->dir);
+    testList->pack = NULL;
+    Manifest manifest = {NULL, 0};
+    PackStore packStore, *store = NULL;
+    if (parameters->pack) {
+        store = &packStore;
+        open_pack_store(parameters->dir, store);
+    } else {
+        read_manifest(parameters->dir, &manifest);
+    }
+    uint64_t programHash = reference_program_hash();
+    int *stale = malloc(testList->numTests * sizeof(int));
+    int numStale = 0;
+    for (int i = 0; i < testList->numTests; i++) {
+        IndividualTest *test = &testList->tests[i];
+        test->expectedHash = test_expected_hash(test, programHash);
+        test->regenerated = false;
+        if (store != NULL
+                ? is_packed_test_fresh(parameters->regen, store, test)
+                : !is_regen_needed(parameters->regen, parameters->dir, test,
+                &manifest) && (test->goodExitStatus = read_expected_exit_status(
+                parameters->dir, test->testID)) != -1) {
+            continue;
+        }
+        if (!parameters->quiet) {
+            printf("Generating expected output for test %s\n", test->testID);
+        }
+        test->regenerated = true;
+        stale[numStale++] = i;
+    }
+    fflush(stdout);
+    qsort_r(stale, numStale, sizeof(int), compare_test_invocations, testList);
+
+    // Each running generator owns a group of adjacent entries in stale. There
+    // are never more generators than stale tests, however large --jobs is.
+    int numSlots = parameters->jobs < numStale ? parameters->jobs : numStale;
+    pid_t *pids = malloc(numSlots * sizeof(pid_t));
+    int *groupStart = malloc(numSlots * sizeof(int));
+    int *groupSize = malloc(numSlots * sizeof(int));
+    int numRunning = 0, next = 0, status;
+    while (next < numStale || numRunning > 0) {
+        while (numRunning < numSlots && next < numStale) {
+            int size = 1;
+            while (next + size < numStale && compare_test_invocations(
+                    &stale[next], &stale[next + size], testList) == 0) {
+                size++;
+            }
+            pid_t pid = fill_expected_output(testList, parameters->dir,
+                    stale[next]);
+            if (pid == -1) {
+                // Recorded the same way as a child whose exec failed.
+                record_expected_outputs(testList, store, parameters->dir,
+                        &stale[next], size, W_EXITCODE(PROCESS_A_EXIT, 0));
+            } else {
+                groupStart[numRunning] = next;
+                groupSize[numRunning] = size;
+                pids[numRunning++] = pid;
+            }
+            next += size;
+        }
+
+        if (numRunning == 0) {
+            continue;
+        }
+        // Sleep until a child exits without reaping it, then reap only the
+        // generator that exited, or the first one still running if the child
+        // isn't one of the generators.
+        siginfo_t exited = {.si_pid = 0};
+        waitid(P_ALL, 0, &exited, WEXITED | WNOWAIT);
+        int i = numRunning - 1;
+        while (i > 0 && pids[i] != exited.si_pid) {
+            i--;
+        }
+        waitpid(pids[i], &status, 0);
+        record_expected_outputs(testList, store, parameters->dir,
+                &stale[groupStart[i]], groupSize[i], status);
+        numRunning--;
+        pids[i] = pids[numRunning];
+        groupStart[i] = groupStart[numRunning];
+        groupSize[i] = groupSize[numRunning];
+    }
+    free(pids);
+    free(groupStart);
+    free(groupSize);
+    free(stale);
+    if (store != NULL) {
+        close_pack_store(store, parameters, testList);
+    } else {
+        write_manifest(parameters, testList, &manifest);
+        free_manifest(&manifest);
+    }
+}
+
+
+/*
+is_sigkilled():
+----------------
+Checks if the test program was killed by a signal (SIGKILL).
+
+arg1: waitStatus - The wait status of the test program.
+
+Returns: true if the test program was killed by a signal; otherwise, false.
+Errors: None
+*/
+bool is_sigkilled(int waitStatus){
+    return WIFSIGNALED(waitStatus);
+}
+
+/*
+is_exec_failed():
+-----------------
+Checks if the test program failed to execute the exec command based on its
+exit status.
+
+arg1: waitStatus - The wait status of the test program.
+arg2: testId - The ID of the test being run.
+arg3: output - The stream to write the test's result lines to.
+
+Returns: true if the test program failed to execute; otherwise, false.
+Errors: Prints an error message to output if exec fails.
+*/
+bool is_exec_failed(int waitStatus, char *testId, FILE *output){
+    //Check if the wait status of the child is the same
+    //as the exit status used when its exec call fails. 
+    if (WEXITSTATUS(waitStatus) == PROCESS_A_EXIT){
+        fprintf(output, "Unable to execute job %s\n", testId);
+        return true;
+    }
+
+    //If the exec succeeded, then return with false. 
+    return false; 
+}
+
+
+/*
+is_standard_out_error_matched():
+--------------------------------
+Checks if the standard output and standard error of a test match
+the expected output and error.
+
+arg1: streams - The comparisons of the test's stdout and stderr.
+arg2: testId - The ID of the test being run.
+arg3: output - The stream to write the test's result lines to.
+
+Returns: true if both standard output and standard error match; otherwise, 
+false.
+Errors: Prints a status message to output depending on the result of the 
+comparison.
+*/
+bool is_standard_out_error_matched(OutputComparison *streams, char *testId,
+        FILE *output){
+    
+    bool standardOutMatched = streams[STDOUT_STREAM].mismatchOffset == -1;
+    bool standardErrorMatched = streams[STDERR_STREAM].mismatchOffset == -1;
+
+    if (standardOutMatched){
+        fprintf(output, "Job %s: Stdout matches\n", testId);
+    }
+
+    else {
+        fprintf(output, "Job %s: Stdout differs\n", testId);
+        fwrite(streams[STDOUT_STREAM].diff, 1, streams[STDOUT_STREAM].diffSize,
+                output);
+    }
+
+    if (standardErrorMatched){
+        fprintf(output, "Job %s: Stderr matches\n", testId);
+    }
+
+    else {
+        fprintf(output, "Job %s: Stderr differs\n", testId);
+        fwrite(streams[STDERR_STREAM].diff, 1, streams[STDERR_STREAM].diffSize,
+                output);
+    }
+
+    if (standardOutMatched && standardErrorMatched){
+        return true;
+    }
+    
+    else{
+    return false;
+    }
+
+}
+
+
+
+/*
+is_exit_status_matched():
+-------------------------
+Checks if the exit status of a test matches the expected exit status.
+
+arg1: waitStatus - The wait status of the test program.
+arg2: goodWaitStatus - The expected exit status.
+arg3: testId - The ID of the test being run.
+arg4: output - The stream to write the test's result lines to.
+
+Returns: true if the exit status matches; otherwise, false.
+Errors: Prints a status message to output.
+*/
+bool is_exit_status_matched(int waitStatus, int goodWaitStatus,
+    char *testId, FILE *output){
+
+    int childExitStatus = WEXITSTATUS(waitStatus);
+    if (childExitStatus == goodWaitStatus){
+        fprintf(output, "Job %s: Exit status matches\n", testId);
+        return true;
+    }
+    
+        else {
+            fprintf(output, "Job %s: Exit status differs\n", testId);
+            return false;
+        }
+
+}
+
+
+ 
+
+/*
+test_job_verdict():
+-------------------
+Works out how the program of a finished test ended. A program killed by
+SIGXCPU, or by SIGKILL once it has used its CPU time, exceeded --cpu-limit.
+An allocation past --mem-limit (RLIMIT_AS) raises no signal of its own: it
+just fails, and the program then usually exits with an error or dies of
+SIGSEGV or SIGABRT. So a program that failed in either way after its
+resident set reached half of --mem-limit is taken to have run out of memory.
+A single allocation too big for the limit fails before the resident set
+grows, so it is judged only on the program's outputs.
+
+arg1: job - The RunningJob for the finished test.
+arg2: parameters - Pointer to CommandLineArgs struct with the limits.
+
+Returns: The verdict (VERDICT_COMPLETED, etc.).
+Errors: None
+*/
+int test_job_verdict(RunningJob *job, CommandLineArgs *parameters) {
+    if (job->killedFor != VERDICT_COMPLETED) {
+        return job->killedFor;
+    }
+    bool signalled = is_sigkilled(job->waitStatus);
+    if (!signalled && WEXITSTATUS(job->waitStatus) == 0) {
+        return VERDICT_COMPLETED;
+    }
+    int signal = signalled ? WTERMSIG(job->waitStatus) : 0;
+    double cpuSeconds = job->usage.ru_utime.tv_sec + job->usage.ru_stime.tv_sec
+            + (job->usage.ru_utime.tv_usec + job->usage.ru_stime.tv_usec) / 1e6;
+    if (parameters->cpuLimit && (signal == SIGXCPU
+            || (signal == SIGKILL && cpuSeconds >= parameters->cpuLimit))) {
+        return VERDICT_CPU;
+    }
+    if (parameters->memoryLimit && (rlim_t)job->usage.ru_maxrss * 1024
+            >= parameters->memoryLimit / 2) {
+        return VERDICT_MEMORY;
+    }
+    return signalled ? VERDICT_SIGNAL : VERDICT_COMPLETED;
+}
+
+/*
+evaluate_test_job():
+--------------------
+Checks the verdict, wait status and output comparisons of a finished test
+and writes the result lines for the test to its output stream.
+
+arg1: testList - Pointer to the TestFileList struct containing the list of tests.
+arg2: job - The RunningJob for the finished test.
+arg3: output - The stream to write the test's result lines to.
+
+Returns: true if the test passed, otherwise false.
+Errors: None
+*/
+bool evaluate_test_job(TestFileList *testList, RunningJob *job,
+        FILE *output) {
+    IndividualTest *test = &testList->tests[job->testIndex];
+    //Check if the test was stopped by a limit or failed through a signal:
+    if (test->verdict == VERDICT_SIGNAL) {
+        fprintf(output, "Job %s: %s %d\n", test->testID,
+                verdictMessages[test->verdict], WTERMSIG(job->waitStatus));
+        return false;
+    } else if (test->verdict != VERDICT_COMPLETED) {
+        fprintf(output, "Job %s: %s\n", test->testID,
+                verdictMessages[test->verdict]);
+        return false;
+    }
+
+    //Check if the exec failed for the test program.
+    if (is_exec_failed(job->waitStatus, test->testID, output) == true){
+        return false;
+    }
+
+    bool standardOutErrorMatched = is_standard_out_error_matched(
+    job->streams, test->testID, output);
+    bool exitStatusMatched = is_exit_status_matched(job->waitStatus,
+    test->goodExitStatus, test->testID, output);
+
+    return standardOutErrorMatched && exitStatusMatched;
+}
+
+/*
+open_output_comparison():
+-------------------------
+Prepares to compare an output stream of a test with its expected output.
+Without --pack the expected output file is mapped into memory; with --pack
+the expected output is already mapped as part of the pack file.
+
+arg1: stream - The OutputComparison struct to set up.
+arg2: fd - The read end of the pipe the test program writes the stream to.
+arg3: expectedFileName - The file holding the expected output, or NULL to
+      use packed.
+arg4: packed - The expected output in the mapped pack file.
+arg5: packedSize - The length of the packed expected output.
+arg6: showDiff - The number of differing lines to show, or 0 for none.
+
+Returns: None
+Errors: An expected output file that can't be opened is treated as empty.
+*/
+void open_output_comparison(OutputComparison *stream, int fd,
+        char *expectedFileName, char *packed, size_t packedSize,
+        int showDiff) {
+    struct stat expectedStat;
+    stream->fd = fd;
+    stream->mapped = false;
+    stream->showDiff = showDiff;
+    stream->window = NULL;
+    stream->diff = NULL;
+    stream->diffSize = 0;
+    stream->expected = NULL;
+    stream->expectedSize = 0;
+    stream->bytesRead = 0;
+    stream->mismatchOffset = -1;
+    if (expectedFileName == NULL) {
+        stream->expected = packedSize ? packed : NULL;
+        stream->expectedSize = packedSize;
+        return;
+    }
+
+    int expectedFD = open(expectedFileName, O_RDONLY | O_CLOEXEC);
+    if (expectedFD == -1) {
+        return;
+    }
+    if (fstat(expectedFD, &expectedStat) == 0 && expectedStat.st_size > 0) {
+        stream->expected = mmap(NULL, expectedStat.st_size, PROT_READ,
+                MAP_PRIVATE, expectedFD, 0);
+        if (stream->expected == MAP_FAILED) {
+            stream->expected = NULL;
+        } else {
+            stream->expectedSize = expectedStat.st_size;
+            stream->mapped = true;
+        }
+    }
+    close(expectedFD);
+}
+
+/*
+start_diff_window():
+--------------------
+Starts keeping the output for --showdiff once the first mismatch is found.
+The window begins DIFF_CONTEXT_LINES lines before the line holding the
+mismatch; the output before the mismatch is the same as the expected output,
+so it is copied from there.
+
+arg1: stream - The comparison that has just found its first mismatch.
+
+Returns: None
+Errors: None
+*/
+void start_diff_window(OutputComparison *stream) {
+    size_t lineStart = stream->mismatchOffset;
+    for (int lines = 0; lines <= DIFF_CONTEXT_LINES && lineStart > 0;
+            lines++) {
+        do {
+            lineStart--;
+        } while (lineStart > 0 && stream->expected[lineStart - 1] != '\n');
+    }
+    if (stream->mismatchOffset - lineStart > DIFF_WINDOW_BYTES) {
+        lineStart = stream->mismatchOffset - DIFF_WINDOW_BYTES;
+    }
+    stream->window = malloc(DIFF_WINDOW_BYTES);
+    stream->windowStart = lineStart;
+    stream->windowSize = stream->mismatchOffset - lineStart;
+    if (stream->windowSize > 0) {
+        memcpy(stream->window, stream->expected + lineStart,
+                stream->windowSize);
+    }
+}
+
+/*
+compare_output_chunk():
+-----------------------
+Compares the next chunk of a test's output with the expected output. Once a
+mismatch has been found the rest of the output is only counted, apart from
+what fits in the --showdiff window.
+
+arg1: stream - The comparison the chunk belongs to.
+arg2: data - The chunk of output.
+arg3: size - The number of bytes in the chunk.
+
+Returns: None
+Errors: None
+*/
+void compare_output_chunk(OutputComparison *stream, char *data, size_t size) {
+    size_t windowFrom = 0;  // Where the bytes for the window start in data.
+    if (stream->mismatchOffset == -1) {
+        size_t remaining = stream->bytesRead < stream->expectedSize
+                ? stream->expectedSize - stream->bytesRead : 0;
+        size_t overlap = size < remaining ? size : remaining;
+        char *expected = stream->expected + stream->bytesRead;
+        if (overlap > 0 && memcmp(expected, data, overlap) != 0) {
+            size_t i = 0;
+            while (expected[i] == data[i]) {
+                i++;
+            }
+            stream->mismatchOffset = stream->bytesRead + i;
+        } else if (size > remaining) {
+            // The program wrote more than was expected.
+            stream->mismatchOffset = stream->expectedSize;
+        }
+        if (stream->mismatchOffset == -1 || !stream->showDiff) {
+            windowFrom = size;
+        } else {
+            windowFrom = stream->mismatchOffset - stream->bytesRead;
+            start_diff_window(stream);
+        }
+    }
+    if (stream->window != NULL) {
+        size_t space = DIFF_WINDOW_BYTES - stream->windowSize;
+        size_t length = size - windowFrom < space ? size - windowFrom : space;
+        memcpy(stream->window + stream->windowSize, data + windowFrom, length);
+        stream->windowSize += length;
+    }
+    stream->bytesRead += size;
+}
+
+/*
+split_diff_lines():
+-------------------
+Splits text into lines for --showdiff, up to DIFF_WINDOW_LINES of them. If
+the text was cut short, a final line without a newline is left out since it
+is probably incomplete.
+
+arg1: text - The text to split.
+arg2: size - The length of the text.
+arg3: truncated - Whether there was more text after this.
+arg4: lines - Array of DIFF_WINDOW_LINES to hold the start of each line.
+arg5: lengths - Array of DIFF_WINDOW_LINES to hold the length of each line,
+      not including its newline.
+
+Returns: The number of lines.
+*/
+int split_diff_lines(char *text, size_t size, bool truncated, char **lines,
+        size_t *lengths) {
+    int numLines = 0;
+    size_t start = 0;
+    while (start < size && numLines < DIFF_WINDOW_LINES) {
+        char *newline = memchr(text + start, '\n', size - start);
+        if (newline == NULL && truncated) {
+            break;
+        }
+        size_t end = newline ? (size_t)(newline - text) : size;
+        lines[numLines] = text + start;
+        lengths[numLines++] = end - start;
+        start = end + 1;
+    }
+    return numLines;
+}
+
+/*
+write_diff_line():
+------------------
+Writes one line of a --showdiff diff with its prefix character.
+*/
+void write_diff_line(FILE *diff, char prefix, char *line, size_t length) {
+    fputc(prefix, diff);
+    fputc(' ', diff);
+    fwrite(line, 1, length, diff);
+    fputc('\n', diff);
+}
+
+/*
+build_diff():
+-------------
+Builds the --showdiff text for an output that differed from its expected
+output. Only the window from the line holding the first mismatch is
+compared, so memory stays bounded however long the outputs are: the lines
+of the two windows are matched up with a longest common subsequence table
+of at most DIFF_WINDOW_LINES squared entries, then the first --showdiff
+differing lines are written with DIFF_CONTEXT_LINES matching lines around
+them, in hunks headed by their expected line number. Expected lines are
+prefixed with '-', actual lines with '+'.
+
+arg1: stream - The comparison to build the diff for.
+
+Returns: None
+Errors: None
+*/
+void build_diff(OutputComparison *stream) {
+    char *expected = stream->expected ? stream->expected + stream->windowStart
+            : "";
+    size_t expectedSize = stream->expectedSize - stream->windowStart;
+    bool expectedTruncated = expectedSize > DIFF_WINDOW_BYTES;
+    expectedSize = expectedTruncated ? DIFF_WINDOW_BYTES : expectedSize;
+    bool actualTruncated = stream->bytesRead
+            > stream->windowStart + stream->windowSize;
+    char *lines[2][DIFF_WINDOW_LINES];
+    size_t lengths[2][DIFF_WINDOW_LINES];
+    int n = split_diff_lines(expected, expectedSize, expectedTruncated,
+            lines[0], lengths[0]);
+    int m = split_diff_lines(stream->window, stream->windowSize,
+            actualTruncated, lines[1], lengths[1]);
+
+    // lcs[i][j] is the length of the longest common subsequence of the
+    // expected lines from i and the actual lines from j.
+    unsigned short (*lcs)[m + 1] = calloc(n + 1, sizeof(*lcs));
+    for (int i = n - 1; i >= 0; i--) {
+        for (int j = m - 1; j >= 0; j--) {
+            if (lengths[0][i] == lengths[1][j]
+                    && memcmp(lines[0][i], lines[1][j], lengths[0][i]) == 0) {
+                lcs[i][j] = lcs[i + 1][j + 1] + 1;
+            } else {
+                lcs[i][j] = lcs[i + 1][j] > lcs[i][j + 1]
+                        ? lcs[i + 1][j] : lcs[i][j + 1];
+            }
+        }
+    }
+
+    // Walk the table, recording each step as '=', '-' or '+' and marking
+    // the steps that are shown.
+    int numSteps = 0, shown = 0, i = 0, j = 0;
+    char steps[n + m];
+    int stepLine[n + m];  // Expected line number before the step.
+    bool visible[n + m], counted[n + m];
+    memset(visible, 0, sizeof(visible));
+    memset(counted, 0, sizeof(counted));
+    while (i < n || j < m) {
+        stepLine[numSteps] = i;
+        if (i < n && j < m && lcs[i][j] == lcs[i + 1][j + 1] + 1
+                && lengths[0][i] == lengths[1][j]
+                && memcmp(lines[0][i], lines[1][j], lengths[0][i]) == 0) {
+            steps[numSteps++] = '=';
+            i++;
+            j++;
+            continue;
+        }
+        if (j == m || (i < n && lcs[i + 1][j] >= lcs[i][j + 1])) {
+            steps[numSteps] = '-';
+            i++;
+        } else {
+            steps[numSteps] = '+';
+            j++;
+        }
+        if (shown < stream->showDiff) {
+            shown++;
+            counted[numSteps] = true;
+            for (int k = numSteps - DIFF_CONTEXT_LINES;
+                    k <= numSteps + DIFF_CONTEXT_LINES; k++) {
+                if (k >= 0 && k < n + m) {
+                    visible[k] = true;
+                }
+            }
+        }
+        numSteps++;
+    }
+    free(lcs);
+
+    // Count the lines before the window to number the hunks.
+    long firstLine = 1;
+    for (size_t k = 0; k < stream->windowStart; k++) {
+        firstLine += stream->expected[k] == '\n';
+    }
+    FILE *diff = open_memstream(&stream->diff, &stream->diffSize);
+    i = j = 0;
+    for (int k = 0; k < numSteps; k++) {
+        if (visible[k] && (k == 0 || !visible[k - 1])) {
+            fprintf(diff, "@@ line %ld @@\n", firstLine + stepLine[k]);
+        }
+        if (visible[k] && (steps[k] == '=' || counted[k])) {
+            if (steps[k] == '+') {
+                write_diff_line(diff, '+', lines[1][j], lengths[1][j]);
+            } else {
+                write_diff_line(diff, steps[k] == '=' ? ' ' : '-',
+                        lines[0][i], lengths[0][i]);
+            }
+        }
+        i += steps[k] != '+';
+        j += steps[k] != '-';
+    }
+    fclose(diff);
+}
+
+/*
+close_output_comparison():
+--------------------------
+Finishes comparing an output stream: closes the pipe, records a mismatch if
+the output was shorter than expected, builds the --showdiff diff, and
+unmaps the expected output.
+
+arg1: stream - The comparison to finish.
+
+Returns: None
+Errors: None
+*/
+void close_output_comparison(OutputComparison *stream) {
+    if (stream->fd != -1) {
+        close(stream->fd);
+        stream->fd = -1;
+    }
+    if (stream->mismatchOffset == -1
+            && stream->bytesRead < stream->expectedSize) {
+        stream->mismatchOffset = stream->bytesRead;
+        if (stream->showDiff) {
+            start_diff_window(stream);
+        }
+    }
+    if (stream->window != NULL) {
+        build_diff(stream);
+        free(stream->window);
+        stream->window = NULL;
+    }
+    if (stream->mapped) {
+        munmap(stream->expected, stream->expectedSize);
+        stream->mapped = false;
+    }
+    stream->expected = NULL;
+}
+
+/*
+read_test_output():
+-------------------
+Reads whatever is available on an output pipe of a running test and
+compares it with the expected output. At end of file the comparison is
+finished.
+
+arg1: stream - The comparison for the pipe that is ready to read.
+
+Returns: None
+Errors: None
+*/
+void read_test_output(OutputComparison *stream) {
+    static char chunk[READ_CHUNK_SIZE];
+    ssize_t bytes = read(stream->fd, chunk, sizeof(chunk));
+    if (bytes > 0) {
+        compare_output_chunk(stream, chunk, bytes);
+    } else if (bytes == 0 || errno != EINTR) {
+        close_output_comparison(stream);
+    }
+}
+
+/*
+limit_test_program():
+---------------------
+Applies --cpu-limit and --mem-limit to the calling process. It is called in
+the child of run_limited_test_program() before the exec, so the limits hold
+from the program's first instruction. The CPU limit is soft, so the program
+gets SIGXCPU, with a hard limit a second later.
+
+arg1: parameters - Pointer to CommandLineArgs struct with the limits.
+
+Returns: None
+Errors: None
+*/
+void limit_test_program(CommandLineArgs *parameters) {
+    if (parameters->cpuLimit) {
+        struct rlimit cpu = {parameters->cpuLimit, parameters->cpuLimit + 1};
+        setrlimit(RLIMIT_CPU, &cpu);
+    }
+    if (parameters->memoryLimit) {
+        struct rlimit memory = {parameters->memoryLimit,
+                parameters->memoryLimit};
+        setrlimit(RLIMIT_AS, &memory);
+    }
+}
+
+/*
+run_limited_test_program():
+---------------------------
+Launches a program for a test with --cpu-limit or --mem-limit. posix_spawn()
+can't set resource limits, so this forks, and the child connects the test's
+input file and the given descriptors like run_test_program() does, applies
+the limits and execs the program.
+
+arg1: test - The test to run the program for.
+arg2: parameters - Pointer to CommandLineArgs struct with the program and
+      the limits.
+arg3: stdoutFD - The descriptor the program's standard output goes to.
+arg4: stderrFD - The descriptor the program's standard error goes to.
+
+Returns: The process ID of the program, or -1 if it could not be started.
+         A child whose exec fails exits with PROCESS_A_EXIT.
+Errors: None
+*/
+pid_t run_limited_test_program(IndividualTest *test, CommandLineArgs *parameters,
+        int stdoutFD, int stderrFD) {
+    int arraySize = test->testArgsCount + 2;
+    char *arguments[arraySize];
+    arguments[0] = parameters->program;
+    for (int k = 1; k < arraySize; k++) {
+        arguments[k] = test->testArgs[k - 1];
+    }
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        int input = open(test->testInputFileName, O_RDONLY);
+        if (input == -1 || dup2(input, STDIN_FILENO) == -1
+                || dup2(stdoutFD, STDOUT_FILENO) == -1
+                || dup2(stderrFD, STDERR_FILENO) == -1) {
+            _exit(PROCESS_A_EXIT);
+        }
+        if (input != STDIN_FILENO) {
+            close(input);
+        }
+        limit_test_program(parameters);
+        execvp(parameters->program, arguments);
+        _exit(PROCESS_A_EXIT);
+    }
+    return pid;
+}
+
+/*
+start_test_job():
+-----------------
+Starts a test job. It spawns the test program with its
+stdout and stderr connected to pipes, which the harness reads and compares
+with the expected output files itself. A pidfd is opened for the child so its
+exit can be polled for, and the test's deadline is set from its "#timeout"
+line or the --timeout value. With --cpu-limit the deadline is no earlier than
+the hard CPU limit plus CPU_LIMIT_GRACE_MS, since a program can't use its CPU
+time any sooner than that and would otherwise always time out first.
+
+arg1: testList - Pointer to the TestFileList struct containing the list of tests.
+arg2: parameters - Pointer to CommandLineArgs struct with command-line arguments.
+arg3: index - The index of the test to start.
+arg4: job - The RunningJob struct to record the test in.
+
+Returns: None
+Errors: A test whose pipes can't be made is reported as unable to execute.
+*/
+void start_test_job(TestFileList *testList, CommandLineArgs *parameters,
+        int index, RunningJob *job) {
+    IndividualTest *test = &testList->tests[index];
+    // Initialize the pipes for the standard out and standard error. They are
+    // close-on-exec so the children of other running tests don't hold them
+    // open. If they can't be made the program isn't started.
+    bool piped = pipe2(test->standardOutCmp, O_CLOEXEC) == 0;
+    if (piped && pipe2(test->standardErrorCmp, O_CLOEXEC) != 0) {
+        close(test->standardOutCmp[READ_END]);
+        close(test->standardOutCmp[WRITE_END]);
+        piped = false;
+    }
+    if (!piped) {
+        test->standardOutCmp[READ_END] = test->standardOutCmp[WRITE_END] = -1;
+        test->standardErrorCmp[READ_END] = -1;
+        test->standardErrorCmp[WRITE_END] = -1;
+    }
+
+    // Get the name of the expected output file for standard output and standard error.
+    char stdoutFileName[PATH_MAX], stderrFileName[PATH_MAX];
+    expected_file_name(stdoutFileName, parameters->dir, test->testID,
+            EXPECTED_STDOUT, false);
+    expected_file_name(stderrFileName, parameters->dir, test->testID,
+            EXPECTED_STDERR, false);
+
+    job->testIndex = index;
+    clock_gettime(CLOCK_MONOTONIC, &job->started);
+    job->wallNs = 0;
+    job->killedFor = VERDICT_COMPLETED;
+    memset(&job->usage, 0, sizeof(job->usage));
+    bool limited = parameters->cpuLimit || parameters->memoryLimit;
+    if (!piped) {
+        job->pid = -1;
+    } else if (limited) {
+        job->pid = run_limited_test_program(test, parameters,
+                test->standardOutCmp[WRITE_END],
+                test->standardErrorCmp[WRITE_END]);
+    } else {
+        job->pid = run_test_program(test, parameters->program,
+                test->standardOutCmp[WRITE_END],
+                test->standardErrorCmp[WRITE_END]);
+    }
+    if (job->pid == -1) {
+        // Reported the same way as a child whose exec failed.
+        job->pidfd = -1;
+        job->waitStatus = W_EXITCODE(PROCESS_A_EXIT, 0);
+    } else {
+        job->pidfd = syscall(SYS_pidfd_open, job->pid, 0);
+    }
+
+    if (piped) {
+        close(test->standardErrorCmp[WRITE_END]);
+        close(test->standardOutCmp[WRITE_END]);
+    }
+    char *fileNames[NUM_OUTPUT_STREAMS] = {stdoutFileName, stderrFileName};
+    int readEnds[NUM_OUTPUT_STREAMS] = {test->standardOutCmp[READ_END],
+            test->standardErrorCmp[READ_END]};
+    for (int i = 0; i < NUM_OUTPUT_STREAMS; i++) {
+        if (parameters->pack) {
+            open_output_comparison(&job->streams[i], readEnds[i], NULL,
+                    testList->pack + test->packOffset[i], test->packLength[i],
+                    parameters->showDiff);
+        } else {
+            open_output_comparison(&job->streams[i], readEnds[i],
+                    fileNames[i], NULL, 0, parameters->showDiff);
+        }
+    }
+
+    long timeoutMs = test->timeoutMs ? test->timeoutMs : parameters->timeoutMs;
+    long cpuTimeoutMs = (parameters->cpuLimit + 1) * 1000L + CPU_LIMIT_GRACE_MS;
+    if (parameters->cpuLimit && cpuTimeoutMs > timeoutMs) {
+        timeoutMs = cpuTimeoutMs;
+    }
+    job->deadline = job->started;
+    job->deadline.tv_sec += timeoutMs / 1000;
+    job->deadline.tv_nsec += timeoutMs % 1000 * 1000000L;
+    if (job->deadline.tv_nsec >= 1000000000L) {
+        job->deadline.tv_sec++;
+        job->deadline.tv_nsec -= 1000000000L;
+    }
+}
+
+/*
+reap_test_program():
+--------------------
+Waits for the program of a running job with wait4() and records its wait
+status, resource usage and wall time.
+
+arg1: job - The running job.
+arg2: options - Options for wait4(): WNOHANG to only reap a program that
+      has already exited.
+
+Returns: true if the program was reaped, otherwise false.
+Errors: None
+*/
+bool reap_test_program(RunningJob *job, int options) {
+    struct timespec now;
+    if (wait4(job->pid, &job->waitStatus, options, &job->usage) <= 0) {
+        return false;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    job->wallNs = (now.tv_sec - job->started.tv_sec) * 1000000000LL
+            + (now.tv_nsec - job->started.tv_nsec);
+    if (job->pidfd != -1) {
+        close(job->pidfd);
+    }
+    job->pid = -1;
+    return true;
+}
+
+/*
+is_job_done():
+--------------
+Checks whether a running job's program has been reaped and both of its
+output pipes have been read to the end.
+
+arg1: job - The running job.
+
+Returns: true if the job is done, otherwise false.
+*/
+bool is_job_done(RunningJob *job) {
+    return job->pid == -1 && job->streams[STDOUT_STREAM].fd == -1
+            && job->streams[STDERR_STREAM].fd == -1;
+}
+
+/*
+milliseconds_until():
+---------------------
+Returns the number of milliseconds from now until a deadline, rounded up,
+or 0 if the deadline has passed.
+
+arg1: deadline - The deadline on the CLOCK_MONOTONIC clock.
+*/
+int milliseconds_until(struct timespec *deadline) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long long ms = (deadline->tv_sec - now.tv_sec) * 1000LL
+            + (deadline->tv_nsec - now.tv_nsec + 999999) / 1000000;
+    if (ms <= 0) {
+        return 0;
+    }
+    return ms > INT_MAX ? INT_MAX : ms;
+}
+
+/*
+wait_for_test_events():
+-----------------------
+Waits until a running program writes output or exits, or the earliest
+deadline passes, using poll() on each job's pidfd and output pipes. Output
+is compared as it arrives, programs that have exited are reaped, and jobs
+that have reached their deadline have their program killed and their pipes
+closed. If a pidfd could not be opened the program is simply left until its
+job's deadline, and is only killed then if it hasn't already exited. A program that writes more than outputLimit bytes is killed
+at once, and its remaining output is drained as usual.
+
+arg1: jobs - The array of running jobs.
+arg2: numRunning - The number of running jobs.
+arg3: outputLimit - The bytes a program may write, or 0 for no limit.
+
+Returns: None
+Errors: None
+*/
+void wait_for_test_events(RunningJob *jobs, int numRunning,
+        size_t outputLimit) {
+    struct pollfd *fds = malloc(numRunning * POLL_SOURCES_PER_JOB
+            * sizeof(struct pollfd));
+    int *owners = malloc(numRunning * POLL_SOURCES_PER_JOB * sizeof(int));
+    int numFds = 0;
+    int timeout = INT_MAX;
+    for (int i = 0; i < numRunning; i++) {
+        int untilDeadline = milliseconds_until(&jobs[i].deadline);
+        timeout = untilDeadline < timeout ? untilDeadline : timeout;
+        int sources[POLL_SOURCES_PER_JOB] = {
+            jobs[i].pid != -1 ? jobs[i].pidfd : -1,
+            jobs[i].streams[STDOUT_STREAM].fd,
+            jobs[i].streams[STDERR_STREAM].fd
+        };
+        for (int j = 0; j < POLL_SOURCES_PER_JOB; j++) {
+            if (sources[j] != -1) {
+                fds[numFds].fd = sources[j];
+                fds[numFds].events = POLLIN;
+                owners[numFds++] = i * POLL_SOURCES_PER_JOB + j;
+            }
+        }
+    }
+
+    if (poll(fds, numFds, timeout) > 0) {
+        for (int k = 0; k < numFds; k++) {
+            if (fds[k].revents == 0) {
+                continue;
+            }
+            RunningJob *job = &jobs[owners[k] / POLL_SOURCES_PER_JOB];
+            int source = owners[k] % POLL_SOURCES_PER_JOB;
+            if (source == 0) {
+                reap_test_program(job, 0);
+            } else {
+                read_test_output(&job->streams[source - 1]);
+                if (outputLimit && job->pid != -1
+                        && job->killedFor == VERDICT_COMPLETED
+                        && job->streams[STDOUT_STREAM].bytesRead
+                        + job->streams[STDERR_STREAM].bytesRead
+                        > outputLimit) {
+                    kill(job->pid, SIGKILL);
+                    job->killedFor = VERDICT_OUTPUT;
+                }
+            }
+        }
+    }
+    free(fds);
+    free(owners);
+
+    for (int i = 0; i < numRunning; i++) {
+        if (is_job_done(&jobs[i])
+                || milliseconds_until(&jobs[i].deadline) > 0) {
+            continue;
+        }
+        if (jobs[i].pid != -1 && !reap_test_program(&jobs[i], WNOHANG)) {
+            kill(jobs[i].pid, SIGKILL);
+            reap_test_program(&jobs[i], 0);
+            if (jobs[i].killedFor == VERDICT_COMPLETED) {
+                jobs[i].killedFor = VERDICT_TIMEOUT;
+            }
+        }
+        for (int j = 0; j < NUM_OUTPUT_STREAMS; j++) {
+            close_output_comparison(&jobs[i].streams[j]);
+        }
+    }
+}
+
+/*
+finish_test_job():
+------------------
+Evaluates a test whose program has been reaped, then prints the
+result lines of every finished test that is not waiting on an earlier test,
+so results always appear in the order the tests were started.
+
+arg1: testList - Pointer to the TestFileList struct containing the list of tests.
+arg2: job - The RunningJob for the finished test.
+arg3: order - The order the tests are run and printed in.
+arg4: nextToPrint - Position in order of the first test whose results are
+      not yet printed.
+arg5: parameters - Pointer to CommandLineArgs struct with command-line
+      arguments; the result lines are discarded with quiet.
+
+Returns: None
+Errors: None
+*/
+void finish_test_job(TestFileList *testList, RunningJob *job, int *order,
+        int *nextToPrint, CommandLineArgs *parameters) {
+    IndividualTest *test = &testList->tests[job->testIndex];
+    FILE *output = open_memstream(&test->report, &test->reportSize);
+    fprintf(output, "Running job: %s\n", test->testID);
+    test->verdict = test_job_verdict(job, parameters);
+    test->passed = evaluate_test_job(testList, job, output);
+    if (test->passed) {
+        testList->testsPassed++;
+    }
+    test->standardOutMismatch = job->streams[STDOUT_STREAM].mismatchOffset;
+    test->standardErrorMismatch = job->streams[STDERR_STREAM].mismatchOffset;
+    test->standardOutBytes = job->streams[STDOUT_STREAM].bytesRead;
+    test->standardErrorBytes = job->streams[STDERR_STREAM].bytesRead;
+    free(job->streams[STDOUT_STREAM].diff);
+    free(job->streams[STDERR_STREAM].diff);
+    test->waitStatus = job->waitStatus;
+    test->wallNs = job->wallNs;
+    test->usage = job->usage;
+    fclose(output);
+    test->finished = true;
+
+    //Increment the number of jobs completed by one:
+    testList->testsCompleted++;
+
+    while (*nextToPrint < testList->numTests
+            && testList->tests[order[*nextToPrint]].finished) {
+        IndividualTest *ready = &testList->tests[order[*nextToPrint]];
+        if (!parameters->quiet) {
+            fwrite(ready->report, 1, ready->reportSize, stdout);
+            fflush(stdout);
+        }
+        free(ready->report);
+        ready->report = NULL;
+        (*nextToPrint)++;
+    }
+}
+
+/*
+compare_history_entries():
+--------------------------
+qsort() and bsearch() comparison function for HistoryEntry structs, by test
+ID.
+*/
+int compare_history_entries(const void *a, const void *b) {
+    return strcmp(((const HistoryEntry *)a)->testId,
+            ((const HistoryEntry *)b)->testId);
+}
+
+/*
+read_history():
+---------------
+Reads each test's previous result and wall time from the history file in
+the expected output directory. Each line holds a test ID, 1 or 0 for passed
+or failed, and the wall time in nanoseconds, separated by tabs. Tests with
+no line, or a malformed one, have no history.
+
+arg1: dir - The directory where the expected output files are stored.
+arg2: testList - Pointer to the TestFileList struct containing the list of tests.
+
+Returns: None
+Errors: None
+*/
+void read_history(char *dir, TestFileList *testList) {
+    char fileName[PATH_MAX];
+    char *line;
+    HistoryEntry *entries = NULL;
+    int numEntries = 0, capacity = 0;
+    snprintf(fileName, PATH_MAX, "%s/%s", dir, HISTORY_FILE_NAME);
+    FILE *historyFile = fopen(fileName, "r");
+    while (historyFile != NULL && (line = read_line(historyFile)) != NULL) {
+        char **fields = split_string(line, '\t');
+        int passed;
+        long long wallNs;
+        char extra;
+        if (fields[1] != NULL && fields[2] != NULL && fields[3] == NULL
+                && sscanf(fields[1], "%d%c", &passed, &extra) == 1
+                && sscanf(fields[2], "%lld%c", &wallNs, &extra) == 1) {
+            if (numEntries == capacity) {
+                capacity = capacity ? capacity * 2 : 64;
+                entries = realloc(entries, capacity * sizeof(HistoryEntry));
+            }
+            entries[numEntries].testId = strdup(fields[0]);
+            entries[numEntries].passed = passed != 0;
+            entries[numEntries++].wallNs = wallNs;
+        }
+        free(fields);
+        free(line);
+    }
+    if (historyFile != NULL) {
+        fclose(historyFile);
+    }
+    qsort(entries, numEntries, sizeof(HistoryEntry), compare_history_entries);
+
+    for (int i = 0; i < testList->numTests; i++) {
+        IndividualTest *test = &testList->tests[i];
+        HistoryEntry key = {.testId = test->testID};
+        HistoryEntry *entry = bsearch(&key, entries, numEntries,
+                sizeof(HistoryEntry), compare_history_entries);
+        test->previousResult = entry ? entry->passed : -1;
+        test->previousWallNs = entry ? entry->wallNs : 0;
+    }
+    for (int i = 0; i < numEntries; i++) {
+        free(entries[i].testId);
+    }
+    free(entries);
+}
+
+/*
+write_history():
+----------------
+Writes the history file for the tests in the job file, replacing the old one
+atomically. Tests that ran record their new result and wall time; tests
+that didn't (because of --fail-fast) keep their previous history. With
+--shard, the old lines of tests in other shards are copied over.
+
+arg1: parameters - The CommandLineArgs struct with the directory where the
+      expected output files are stored and the shard.
+arg2: testList - Pointer to the TestFileList struct containing the list of tests.
+
+Returns: None
+Errors: None
+*/
+void write_history(CommandLineArgs *parameters, TestFileList *testList) {
+    char fileName[PATH_MAX], tempFileName[PATH_MAX];
+    char *dir = parameters->dir;
+    snprintf(fileName, PATH_MAX, "%s/%s", dir, HISTORY_FILE_NAME);
+    snprintf(tempFileName, PATH_MAX, "%s/%s.tmp", dir, HISTORY_FILE_NAME);
+    FILE *historyFile = fopen(tempFileName, "w");
+    if (historyFile == NULL) {
+        return;
+    }
+    for (int i = 0; i < testList->numTests; i++) {
+        IndividualTest *test = &testList->tests[i];
+        if (test->finished) {
+            fprintf(historyFile, "%s\t%d\t%lld\n", test->testID, test->passed,
+                    test->wallNs);
+        } else if (test->previousResult != -1) {
+            fprintf(historyFile, "%s\t%d\t%lld\n", test->testID,
+                    test->previousResult, test->previousWallNs);
+        }
+    }
+    FILE *oldHistoryFile = parameters->shardCount ? fopen(fileName, "r") : NULL;
+    char *line;
+    while (oldHistoryFile != NULL
+            && (line = read_line(oldHistoryFile)) != NULL) {
+        char *tab = strchr(line, '\t');
+        if (tab != NULL) {
+            *tab = '\0';
+            if (!is_in_shard(parameters, line)) {
+                fprintf(historyFile, "%s\t%s\n", line, tab + 1);
+            }
+        }
+        free(line);
+    }
+    if (oldHistoryFile != NULL) {
+        fclose(oldHistoryFile);
+    }
+    fclose(historyFile);
+    rename(tempFileName, fileName);
+}
+
+/*
+test_priority():
+----------------
+Returns the scheduling class of a test for --prioritise: 0 if it failed last
+time, 1 if it is new or its expected outputs were just regenerated, and 2
+otherwise.
+*/
+int test_priority(IndividualTest *test) {
+    if (test->previousResult == 0) {
+        return 0;
+    }
+    return test->previousResult == -1 || test->regenerated ? 1 : 2;
+}
+
+/*
+compare_test_priorities():
+--------------------------
+qsort_r() comparison function for --prioritise. Tests are ordered by
+test_priority(), then longest previous wall time first so long tests don't
+end up running alone at the end under --jobs, then by job file order.
+
+arg1: a - Pointer to the first test index.
+arg2: b - Pointer to the second test index.
+arg3: context - The TestFileList struct containing the tests.
+*/
+int compare_test_priorities(const void *a, const void *b, void *context) {
+    TestFileList *testList = context;
+    int indexA = *(const int *)a, indexB = *(const int *)b;
+    IndividualTest *testA = &testList->tests[indexA];
+    IndividualTest *testB = &testList->tests[indexB];
+    int priorityA = test_priority(testA), priorityB = test_priority(testB);
+    if (priorityA != priorityB) {
+        return priorityA - priorityB;
+    }
+    if (testA->previousWallNs != testB->previousWallNs) {
+        return testA->previousWallNs > testB->previousWallNs ? -1 : 1;
+    }
+    return indexA - indexB;
+}
+
+/*
+running_tests_job_real():
+-------------------------
+Responsible for running each test job in the tests array of the testFileList
+structure. Up to --jobs tests run at once, each as a single child process
+whose output the harness compares itself (see start_test_job()). A test
+finishes as soon as its program has exited and its output has been read;
+only a test that is still running at its deadline has its program killed.
+Tests run in job file order, or in history order with --prioritise (see
+compare_test_priorities()). With --fail-fast no more tests are started once
+one has failed. Each test's result is then saved to the history file.
+
+arg1: testList - Pointer to the TestFileList struct containing the list of tests.
+arg2: parameters - Pointer to CommandLineArgs struct with command-line arguments.
+
+Returns: None
+Errors: None
+*/
+void running_tests_job_real(TestFileList *testList, CommandLineArgs *parameters) {
+    //Initialize the number of tests completed to 0 and passed.
+    testList->testsCompleted = 0;
+    testList->testsPassed = 0;
+    int *order = malloc(testList->numTests * sizeof(int));
+    for (int i = 0; i < testList->numTests; i++) {
+        testList->tests[i].finished = false;
+        testList->tests[i].passed = false;
+        testList->tests[i].slower = false;
+        testList->tests[i].report = NULL;
+        order[i] = i;
+    }
+    read_history(parameters->dir, testList);
+    if (parameters->prioritise) {
+        qsort_r(order, testList->numTests, sizeof(int),
+                compare_test_priorities, testList);
+    }
+    fflush(stdout);
+
+    // There are never more job slots than tests, however large --jobs is.
+    int numSlots = parameters->jobs < testList->numTests ? parameters->jobs
+            : testList->numTests;
+    RunningJob *jobs = malloc(numSlots * sizeof(RunningJob));
+    int numRunning = 0, nextToStart = 0, nextToPrint = 0;
+    int numToStart = testList->numTests;
+    while (nextToStart < numToStart || numRunning > 0) {
+        // Start tests until every job slot is in use.
+        while (numRunning < numSlots && nextToStart < numToStart) {
+            start_test_job(testList, parameters, order[nextToStart++],
+                    &jobs[numRunning++]);
+        }
+
+        wait_for_test_events(jobs, numRunning, parameters->outputLimit);
+        for (int i = numRunning - 1; i >= 0; i--) {
+            if (is_job_done(&jobs[i])) {
+                finish_test_job(testList, &jobs[i], order, &nextToPrint,
+                        parameters);
+                if (parameters->failFast
+                        && !testList->tests[jobs[i].testIndex].passed) {
+                    numToStart = nextToStart;
+                }
+                jobs[i] = jobs[--numRunning];
+            }
+        }
+    }
+    write_history(parameters, testList);
+    free(jobs);
+    free(order);
+}
+
+
+/*
+bench_run_once():
+-----------------
+Runs a program once for a test with its output discarded, and measures it.
+The run is killed if it takes longer than the test's time limit.
+
+arg1: test - The test to run the program for.
+arg2: program - The program to run.
+arg3: devNull - A descriptor open for writing to /dev/null.
+arg4: timeoutMs - The time limit for the run.
+arg5: wallNs - Set to the wall time of the run.
+arg6: maxRss - Set to the maximum resident set size of the run, in kB.
+
+Returns: true if the run finished within the time limit, otherwise false.
+Errors: None
+*/
+bool bench_run_once(IndividualTest *test, char *program, int devNull,
+        long timeoutMs, long long *wallNs, long long *maxRss) {
+    RunningJob job;
+    clock_gettime(CLOCK_MONOTONIC, &job.started);
+    job.pid = run_test_program(test, program, devNull, devNull);
+    if (job.pid == -1) {
+        return false;
+    }
+    job.pidfd = syscall(SYS_pidfd_open, job.pid, 0);
+    struct pollfd exited = {.fd = job.pidfd, .events = POLLIN};
+    bool finished = job.pidfd == -1 || poll(&exited, 1, timeoutMs) == 1;
+    if (!finished) {
+        kill(job.pid, SIGKILL);
+    }
+    reap_test_program(&job, 0);
+    *wallNs = job.wallNs;
+    *maxRss = job.usage.ru_maxrss;
+    return finished;
+}
+
+/*
+compare_samples():
+------------------
+qsort() comparison function for long long benchmark samples.
+*/
+int compare_samples(const void *a, const void *b) {
+    long long sampleA = *(const long long *)a;
+    long long sampleB = *(const long long *)b;
+    return (sampleA > sampleB) - (sampleA < sampleB);
+}
+
+/*
+summarise_samples():
+--------------------
+Sorts a set of benchmark samples and finds their median, 95th percentile
+(nearest rank) and a distribution-free 95% confidence interval for the
+median, taken from the order statistics n/2 -/+ 1.96 sqrt(n)/2. The ranks
+are worked out in integers so that no maths library is needed.
+
+arg1: samples - The samples. They are sorted in place.
+arg2: numSamples - The number of samples.
+
+Returns: The summary of the samples.
+*/
+SampleSummary summarise_samples(long long *samples, int numSamples) {
+    SampleSummary summary;
+    qsort(samples, numSamples, sizeof(long long), compare_samples);
+    // The smallest width with (100 * width)^2 >= 196^2 * n, that is
+    // width >= 1.96 sqrt(n), so that low and high are the floor and ceiling
+    // of (n -/+ width) / 2.
+    long long width = 0;
+    while (10000 * width * width < 38416LL * numSamples) {
+        width++;
+    }
+    int low = (numSamples - width) / 2;
+    int high = (numSamples + width + 1) / 2;
+    int p95 = (95 * numSamples + 99) / 100 - 1;
+    summary.median = numSamples % 2 ? samples[numSamples / 2]
+            : (samples[numSamples / 2 - 1] + samples[numSamples / 2]) / 2;
+    summary.low = samples[low > 0 ? low : 0];
+    summary.high = samples[high < numSamples ? high : numSamples - 1];
+    summary.p95 = samples[p95 > 0 ? p95 : 0];
+    return summary;
+}
+
+/*
+print_bench_summary():
+----------------------
+Prints the benchmark results of one program for a test.
+
+arg1: testId - The ID of the test.
+arg2: program - The name of the program.
+arg3: wall - The summary of the wall times, in nanoseconds.
+arg4: rss - The summary of the maximum resident set sizes, in kB.
+*/
+void print_bench_summary(char *testId, char *program, SampleSummary *wall,
+        SampleSummary *rss) {
+    printf("Bench %s: %s median %.3f ms (95%% CI %.3f-%.3f) p95 %.3f ms, "
+            "max RSS %lld kB (95%% CI %lld-%lld)\n", testId, program,
+            wall->median / 1e6, wall->low / 1e6, wall->high / 1e6,
+            wall->p95 / 1e6, rss->median, rss->low, rss->high);
+}
+
+/*
+benchmark_test():
+-----------------
+Runs the program under test and good-uqwordladder --bench times each for a
+test, alternating between them so drift in machine load affects both
+equally, and prints their statistics. The program counts as slower if the
+lower bound of its median wall time's confidence interval is more than
+--threshold percent above the upper bound of the reference's.
+
+arg1: test - The test to benchmark.
+arg2: parameters - Pointer to CommandLineArgs struct with command-line arguments.
+arg3: devNull - A descriptor open for writing to /dev/null.
+
+Returns: true if the program under test is slower than the reference.
+Errors: None
+*/
+bool benchmark_test(IndividualTest *test, CommandLineArgs *parameters,
+        int devNull) {
+    char *programs[2] = {parameters->program, "good-uqwordladder"};
+    long long *wall[2], *rss[2];
+    SampleSummary wallSummary[2], rssSummary[2];
+    long timeoutMs = test->timeoutMs ? test->timeoutMs : parameters->timeoutMs;
+    bool finished = true;
+
+    for (int p = 0; p < 2; p++) {
+        wall[p] = malloc(parameters->benchRuns * sizeof(long long));
+        rss[p] = malloc(parameters->benchRuns * sizeof(long long));
+    }
+    for (int run = 0; run < parameters->benchRuns && finished; run++) {
+        for (int p = 0; p < 2; p++) {
+            finished = finished && bench_run_once(test, programs[p], devNull,
+                    timeoutMs, &wall[p][run], &rss[p][run]);
+        }
+    }
+
+    bool slower = false;
+    if (!finished) {
+        printf("Bench %s: a run did not finish\n", test->testID);
+        slower = true;
+    } else {
+        for (int p = 0; p < 2; p++) {
+            wallSummary[p] = summarise_samples(wall[p], parameters->benchRuns);
+            rssSummary[p] = summarise_samples(rss[p], parameters->benchRuns);
+            print_bench_summary(test->testID, programs[p], &wallSummary[p],
+                    &rssSummary[p]);
+        }
+        if (wallSummary[0].low > wallSummary[1].high
+                * (1 + parameters->benchThreshold / 100)) {
+            printf("Bench %s: %s is slower than good-uqwordladder\n",
+                    test->testID, parameters->program);
+            slower = true;
+        }
+    }
+    fflush(stdout);
+    for (int p = 0; p < 2; p++) {
+        free(wall[p]);
+        free(rss[p]);
+    }
+    return slower;
+}
+
+/*
+run_benchmarks():
+-----------------
+Benchmarks every test that passed against good-uqwordladder (see
+benchmark_test()), one run at a time so runs don't compete for the CPU.
+
+arg1: testList - Pointer to the TestFileList struct containing the list of tests.
+arg2: parameters - Pointer to CommandLineArgs struct with command-line arguments.
+
+Returns: None
+Errors: None
+*/
+void run_benchmarks(TestFileList *testList, CommandLineArgs *parameters) {
+    int devNull = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    testList->benchRegressions = 0;
+    for (int i = 0; i < testList->numTests; i++) {
+        IndividualTest *test = &testList->tests[i];
+        test->slower = test->passed
+                && benchmark_test(test, parameters, devNull);
+        testList->benchRegressions += test->slower;
+    }
+    close(devNull);
+}
+
+/*
+report_on_test_jobs():
+----------------------
+Generates a report on the number of tests passed and completed, and on
+the number of tests that --bench found slower than good-uqwordladder. It also
+determines the overall exit status of the program based on these numbers.
+
+arg1: testList - Pointer to the TestFileList struct containing the list of tests.
+
+Returns: None
+Errors: Exits with exit status 0 if all tests passed and none were slower;
+otherwise, exits with exit status 7.
+*/
+void report_on_test_jobs(TestFileList *testList){
+    //If at least one test has been completed, print the result: 
+    if (testList->testsCompleted > 0){
+        int testsPassed = testList->testsPassed;
+        int testsCompleted = testList->testsCompleted;
+        printf("testuqwordladder: %d of %d tests passes\n", testsPassed, testsCompleted);
+        if (testList->benchRegressions > 0) {
+            printf("testuqwordladder: %d tests slower than good-uqwordladder\n",
+                    testList->benchRegressions);
+        }
+    
+        //If all test have passed exit with stautus 0: 
+        if (testsPassed == testsCompleted && testList->benchRegressions == 0){
+            exit(OVERALL_TEST_RESULT_PASS);
+        }
+
+        else{
+            exit(OVERALL_TEST_RESULT_FAIL);
+        }
+    }
+
+}
+
+/*
+timeval_ms():
+-------------
+Converts a CPU time from struct rusage to milliseconds.
+*/
+double timeval_ms(struct timeval time) {
+    return time.tv_sec * 1000.0 + time.tv_usec / 1000.0;
+}
+
+/*
+write_json_string():
+--------------------
+Writes a string as a JSON string literal, escaping it as needed.
+
+arg1: file - The stream to write to.
+arg2: string - The string to write.
+*/
+void write_json_string(FILE *file, const char *string) {
+    fputc('"', file);
+    for (const unsigned char *c = (const unsigned char *)string; *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            fprintf(file, "\\%c", *c);
+        } else if (*c < ' ') {
+            fprintf(file, "\\u%04x", *c);
+        } else {
+            fputc(*c, file);
+        }
+    }
+    fputc('"', file);
+}
+
+/*
+write_results_report():
+-----------------------
+Writes a machine-readable report of every test to the --report file: whether
+it passed, how the program exited, its wall time, user and system CPU time,
+maximum resident set size, the bytes it wrote to stdout and stderr, and the
+offset of the first differing byte of each (-1 if none), whether --bench
+found it slower than good-uqwordladder, and its verdict: passed, failed, or
+how its program was stopped (see TestVerdict). The report is JSON if the file name
+ends in ".json", otherwise tab-separated values with a header line, which
+--merge can combine.
+
+arg1: parameters - Pointer to CommandLineArgs struct with command-line arguments.
+arg2: testList - Pointer to the TestFileList struct containing the list of tests.
+
+Returns: None
+Errors: Exits with exit status of 11 if the report can't be opened for
+        writing.
+*/
+void write_results_report(CommandLineArgs *parameters, TestFileList *testList) {
+    size_t nameLength = strlen(parameters->report);
+    bool json = nameLength >= 5
+            && strcmp(parameters->report + nameLength - 5, ".json") == 0;
+    FILE *report = fopen(parameters->report, "w");
+    if (report == NULL) {
+        fprintf(stderr,
+                "testuqwordladder: Can't open file \"%s\" for writing\n",
+                parameters->report);
+        exit(OPEN_FILE_ERROR);
+    }
+
+    if (json) {
+        fprintf(report, "[\n");
+    } else {
+        fprintf(report, "%s\n", RESULTS_REPORT_HEADER);
+    }
+    bool first = true;
+    for (int i = 0; i < testList->numTests; i++) {
+        IndividualTest *test = &testList->tests[i];
+        if (!test->finished) {
+            continue;  // Not started because of --fail-fast.
+        }
+        int exitStatus = WIFEXITED(test->waitStatus)
+                ? WEXITSTATUS(test->waitStatus) : -1;
+        int signal = WIFSIGNALED(test->waitStatus)
+                ? WTERMSIG(test->waitStatus) : 0;
+        const char *verdict = test->passed ? "passed"
+                : verdictNames[test->verdict];
+        if (json) {
+            fprintf(report, "%s  {\"id\": ", first ? "" : ",\n");
+            write_json_string(report, test->testID);
+            fprintf(report, ", \"passed\": %s, \"exit_status\": %d, "
+                    "\"signal\": %d, \"wall_ms\": %.3f, \"user_ms\": %.3f, "
+                    "\"sys_ms\": %.3f, \"max_rss_kb\": %ld, "
+                    "\"stdout_bytes\": %zu, \"stderr_bytes\": %zu, "
+                    "\"stdout_mismatch\": %ld, \"stderr_mismatch\": %ld, "
+                    "\"slower\": %s, \"verdict\": \"%s\"}",
+                    test->passed ? "true" : "false", exitStatus, signal,
+                    test->wallNs / 1e6, timeval_ms(test->usage.ru_utime),
+                    timeval_ms(test->usage.ru_stime), test->usage.ru_maxrss,
+                    test->standardOutBytes, test->standardErrorBytes,
+                    test->standardOutMismatch, test->standardErrorMismatch,
+                    test->slower ? "true" : "false", verdict);
+        } else {
+            fprintf(report, "%s\t%d\t%d\t%d\t%.3f\t%.3f\t%.3f\t%ld\t%zu\t%zu\t"
+                    "%ld\t%ld\t%d\t%s\n", test->testID, test->passed, exitStatus,
+                    signal, test->wallNs / 1e6,
+                    timeval_ms(test->usage.ru_utime),
+                    timeval_ms(test->usage.ru_stime), test->usage.ru_maxrss,
+                    test->standardOutBytes, test->standardErrorBytes,
+                    test->standardOutMismatch, test->standardErrorMismatch,
+                    test->slower, verdict);
+        }
+        first = false;
     }
-    if (compare_timespecs(jobFileStat.st_mtim, exitFileStat.st_mtim) > 0) {
-        return true;
+    if (json) {
+        fprintf(report, "%s]\n", first ? "" : "\n");
     }
-    return false;
+    fclose(report);
 }
 
 /*
-close_file_handlers():
-----------------------
-Closes the file handlers for each test in the TestFileList struct.
+parse_results_row():
+--------------------
+Parses a line of a tab-separated --report file into a finished test.
 
-arg1: testList - The TestFileList struct containing the tests.
+arg1: line - The line, which is changed to end after the test ID.
+arg2: test - The IndividualTest struct to fill in.
 
-Returns: None
+Returns: true if the line is a valid result line, otherwise false.
 Errors: None
 */
-void close_file_handlers(TestFileList *testList) {
-    for (int i = 0; i < testList->numTests; i++) {
-        fclose(testList->tests[i].testInputFileHandler);
-        fclose(testList->tests[i].goodStandOutFileHandler);
-        fclose(testList->tests[i].goodStandErrorFileHandler);
-        fclose(testList->tests[i].goodExitStatusFileHandler);
+bool parse_results_row(char *line, IndividualTest *test) {
+    int passed, exitStatus, signal, slower, consumed = -1;
+    double wallMs, userMs, sysMs;
+    long maxRss;
+    char verdict[16];
+    char *tab = strchr(line, '\t');
+    if (tab == NULL || tab == line || sscanf(tab, "\t%d\t%d\t%d\t%lf\t%lf\t%lf"
+            "\t%ld\t%zu\t%zu\t%ld\t%ld\t%d\t%15[a-z]%n", &passed,
+            &exitStatus, &signal, &wallMs, &userMs, &sysMs, &maxRss,
+            &test->standardOutBytes, &test->standardErrorBytes,
+            &test->standardOutMismatch, &test->standardErrorMismatch, &slower,
+            verdict, &consumed) != 13 || tab[consumed] != '\0') {
+        return false;
     }
+    test->verdict = strcmp(verdict, "passed") == 0 ? VERDICT_COMPLETED : -1;
+    for (int i = 0; i < NUM_VERDICTS && test->verdict == -1; i++) {
+        if (strcmp(verdict, verdictNames[i]) == 0) {
+            test->verdict = i;
+        }
+    }
+    if (test->verdict == -1) {
+        return false;
+    }
+    *tab = '\0';
+    char *fields[] = {line, "", NULL};
+    IndividualTest parsed = create_new_individual_test(fields);
+    test->testID = parsed.testID;
+    test->testInputFileName = parsed.testInputFileName;
+    test->testArgs = parsed.testArgs;
+    test->testArgsCount = parsed.testArgsCount;
+    test->timeoutMs = 0;
+    test->passed = passed;
+    test->slower = slower;
+    test->waitStatus = signal ? signal : W_EXITCODE(exitStatus & 0xff, 0);
+    test->wallNs = wallMs * 1e6;
+    memset(&test->usage, 0, sizeof(test->usage));
+    long long userUs = userMs * 1000 + 0.5, sysUs = sysMs * 1000 + 0.5;
+    test->usage.ru_utime.tv_sec = userUs / 1000000;
+    test->usage.ru_utime.tv_usec = userUs % 1000000;
+    test->usage.ru_stime.tv_sec = sysUs / 1000000;
+    test->usage.ru_stime.tv_usec = sysUs % 1000000;
+    test->usage.ru_maxrss = maxRss;
+    test->report = NULL;
+    test->finished = true;
+    return true;
 }
 
 /*
-generating_expected_outputs():
------------------------------
-Creates all expected output files for each test in the TestFileList struct. 
-It iterates through each test, generates the expected output, and then closes
-the file handlers.
+json_results_row():
+-------------------
+Rewrites a test's line of a JSON --report file, as written by
+write_results_report(), as the same test's line of a tab-separated report.
 
-arg1: parameters - The CommandLineArgs struct containing command line 
-arguments such as the directory name to  store the expected output files.
-arg2: testList - The TestFileList struct containing the tests to generate expected output for.
+arg1: line - The line of the JSON report.
 
-Returns: None
+Returns: The tab-separated line, which the caller frees, or NULL if the line
+         isn't a test written by write_results_report().
 Errors: None
 */
-
-void generating_expected_outputs(CommandLineArgs *parameters,
-                                 TestFileList *testList) {
-    make_test_directory(parameters->dir);
-    for (int i = 0; i < testList->numTests; i++) {
-        printf("Generating expected output for test %s\n",
-               testList->tests[i].testID);
-        create_expected_output_file(testList, parameters->dir, i);
-        fill_expected_output(testList, i);
+char *json_results_row(char *line) {
+    char *id = malloc(strlen(line) + 1), *rest = strchr(line, '"');
+    size_t idLength = 0;
+    int consumed = -1;
+    unsigned int code;
+    if (sscanf(line, " {\"id\": %n", &consumed) != 0 || consumed == -1
+            || line[consumed] != '"') {
+        free(id);
+        return NULL;
     }
-    //Check if regen is required:
-    for (int i = 0; i < testList->numTests; i++) {
-        if (is_regen_needed(parameters->regen,
-        parameters->jobFile, testList, i) == true) {
-        printf("Generating expected output for test %s\n", testList->tests[i].testID);
-        create_expected_output_file(testList, parameters->dir, i);
-        fill_expected_output(testList, i);
+    // Undo write_json_string()'s escapes up to the closing quote.
+    for (rest = line + consumed + 1; rest != NULL && *rest != '"'; rest++) {
+        if (*rest == '\0' || (unsigned char)*rest < ' ' || *rest == '\t') {
+            rest = NULL;
+        } else if (*rest != '\\') {
+            id[idLength++] = *rest;
+        } else if (rest[1] == '"' || rest[1] == '\\') {
+            id[idLength++] = *++rest;
+        } else if (rest[1] == 'u' && sscanf(rest + 2, "%4x", &code) == 1
+                && code != 0 && code < ' ' && code != '\t') {
+            id[idLength++] = code;
+            rest += 5;
         } else {
-        continue;
+            rest = NULL;
         }
-    }   
-
-    close_file_handlers(testList);
+        if (rest == NULL) {
+            break;
+        }
+    }
+    id[idLength] = '\0';
+
+    char passed[6], slower[6], verdict[16];
+    int exitStatus, signal;
+    double wallMs, userMs, sysMs;
+    long maxRss, stdoutMismatch, stderrMismatch;
+    size_t stdoutBytes, stderrBytes;
+    consumed = -1;
+    if (rest == NULL || idLength == 0 || sscanf(rest, "\", \"passed\": "
+            "%5[a-z], \"exit_status\": %d, \"signal\": %d, "
+            "\"wall_ms\": %lf, \"user_ms\": %lf, \"sys_ms\": %lf, "
+            "\"max_rss_kb\": %ld, \"stdout_bytes\": %zu, "
+            "\"stderr_bytes\": %zu, \"stdout_mismatch\": %ld, "
+            "\"stderr_mismatch\": %ld, \"slower\": %5[a-z], "
+            "\"verdict\": \"%15[a-z]\"}%n", passed, &exitStatus, &signal,
+            &wallMs, &userMs, &sysMs, &maxRss, &stdoutBytes, &stderrBytes,
+            &stdoutMismatch, &stderrMismatch, slower, verdict, &consumed) != 13
+            || consumed == -1 || strspn(rest + consumed, ", ")
+            != strlen(rest + consumed)
+            || (strcmp(passed, "true") != 0 && strcmp(passed, "false") != 0)
+            || (strcmp(slower, "true") != 0 && strcmp(slower, "false") != 0)) {
+        free(id);
+        return NULL;
+    }
+    char *row;
+    if (asprintf(&row, "%s\t%d\t%d\t%d\t%.3f\t%.3f\t%.3f\t%ld\t%zu\t%zu\t"
+            "%ld\t%ld\t%d\t%s", id, strcmp(passed, "true") == 0, exitStatus,
+            signal, wallMs, userMs, sysMs, maxRss, stdoutBytes, stderrBytes,
+            stdoutMismatch, stderrMismatch, strcmp(slower, "true") == 0,
+            verdict) == -1) {
+        row = NULL;
+    }
+    free(id);
+    return row;
 }
 
-
 /*
-run_test_program():
--------------------
-Runs the test program for a specific test. It redirects standard I/O to 
-specific pipes and files, prepares the arguments for the test program,
- and then executes it.
+read_results_report():
+----------------------
+Adds the tests in a --report file to the merged results. The file can be
+tab-separated or JSON; a JSON report's tests are read through
+json_results_row().
 
-arg1: testList - A pointer to the TestFileList struct that holds all 
-the test information.
-arg2: testProgram - The name of the test program to run.
-arg3: index - The index of the specific test to run within the testList.
+arg1: fileName - The report file.
+arg2: testList - The TestFileList struct of the merged results.
+arg3: testIds - The IDs of the tests merged so far.
 
 Returns: None
-Errors: Exits with PROCESS_A_EXIT (ex) if execvp fails.
+Errors: Exits with exit status 11 if the file can't be opened, 1 if it isn't
+        a report written by --report, or 17 if a test is in more than one
+        report.
 */
-void run_test_program(TestFileList *testList, char *testProgram, int index){
-    //Open the input file for the test. 
-    int testInputFileDescrip = open(testList->tests[index].testInputFileName,
-    O_RDONLY);
-
-    //Redirect the standard input to the test input file handler.
-    dup2(testInputFileDescrip, STDIN_FILENO);
-    //Redirect standardout, standard error to the write end of their pipes.
-    dup2(testList->tests[index].standardOutCmp[WRITE_END], STDOUT_FILENO);
-    dup2(testList->tests[index].standardErrorCmp[WRITE_END], STDERR_FILENO);
-
-    //Close the input file and the write end of both pipes. 
-    close(testInputFileDescrip);
-    close(testList->tests[index].standardOutCmp[WRITE_END]);
-    close(testList->tests[index].standardErrorCmp[WRITE_END]); 
+void read_results_report(char *fileName, TestFileList *testList,
+        StringSet *testIds) {
+    FILE *report = fopen(fileName, "r");
+    if (report == NULL) {
+        fprintf(stderr, "testuqwordladder: Unable to open report file \"%s\"\n",
+                fileName);
+        exit(OPEN_FILE_ERROR);
+    }
+    char *line;
+    int lineNum = 0;
+    bool valid = true, json = false, ended = false;
+    while (valid && (line = read_line(report)) != NULL) {
+        lineNum++;
+        if (lineNum == 1) {
+            json = strcmp(line, "[") == 0;
+            valid = json || strcmp(line, RESULTS_REPORT_HEADER) == 0;
+        } else if (ended || (json && strcmp(line, "]") == 0)) {
+            valid = !ended;
+            ended = true;
+        } else {
+            IndividualTest test;
+            char *row = json ? json_results_row(line) : line;
+            valid = row != NULL && parse_results_row(row, &test);
+            if (json) {
+                free(row);
+            }
+            if (valid) {
+                if (!check_new_test_id(testIds, test.testID)) {
+                    same_test_id_error(fileName, lineNum);
+                }
+                add_individual_test(test, testList);
+                testList->testsCompleted++;
+                testList->testsPassed += test.passed;
+                testList->benchRegressions += test.slower;
+            }
+        }
+        free(line);
+    }
+    if (!valid || lineNum == 0 || json != ended) {
+        fprintf(stderr, "testuqwordladder: Syntax error on line %d of report "
+                "file \"%s\"\n", lineNum ? lineNum : 1, fileName);
+        exit(SYNTAX_ERROR);
+    }
+    fclose(report);
+}
 
-    //Close the read end of both pipes, only writing is done in this process.
-    close(testList->tests[index].standardOutCmp[READ_END]);
-    close(testList->tests[index].standardErrorCmp[READ_END]);
+/*
+merge_results_reports():
+------------------------
+Runs --merge: combines the tab-separated or JSON --report files written by
+the --shard processes, optionally writes them to one --report file, and prints
+the summary and exits exactly as a single run of every test would.
 
-    //Create the arguments for the command to to execute. 
-    //The total argument size is the number of arguments + 2(accounting for 
-    //the program name and the NULL value at the end of the array).
-    int arraySize = testList->tests[index].testArgsCount + 2;
-    char *arguments[arraySize];
+arg1: argc - The number of command-line arguments.
+arg2: argv[] - The command-line arguments, starting with --merge.
 
-    //Copy the program name into the array. 
-    arguments[0] = testProgram;
-    //Copy the command line arguments into the arguments array. 
-    //The command line arguments are stored in the  testArgs variable.
-    for (int k = 1; k < arraySize; k++){
-        arguments[k] = testList->tests[index].testArgs[k-1]; 
+Returns: None (This function exits the program)
+Errors: Exits with exit status 9 for invalid arguments, and as for
+        read_results_report() and report_on_test_jobs().
+*/
+void merge_results_reports(int argc, char *argv[]) {
+    CommandLineArgs parameters = {.report = NULL};
+    int first = 2;
+    if (argc > first && strcmp(argv[first], "--report") == 0) {
+        if (argc < first + 2) {
+            command_line_error();
+        }
+        parameters.report = argv[first + 1];
+        first += 2;
+    }
+    if (first >= argc) {
+        command_line_error();
     }
 
-    //Exec the program with the arguments
-    execvp(arguments[0], arguments);
-
-    //ExiT if execvp fails. 
-    _exit(PROCESS_A_EXIT); 
-
+    TestFileList testList = {.numTests = 0, .capacity = 0, .tests = NULL,
+            .testsCompleted = 0, .testsPassed = 0, .benchRegressions = 0};
+    StringSet testIds = {calloc(64, sizeof(char *)), 64, 0};
+    for (int i = first; i < argc; i++) {
+        read_results_report(argv[i], &testList, &testIds);
+    }
+    free(testIds.slots);
+    if (parameters.report != NULL) {
+        write_results_report(&parameters, &testList);
+    }
+    report_on_test_jobs(&testList);
+    exit(OVERALL_TEST_RESULT_PASS);
 }
 
 /*
-compare_standard_out():
------------------------
-Compares the standard output of a test program with its expected standard
-output. This is done my redirecting the standard input to the read end of 
-the standardOutCmp and then running the 'cmp' program.
+fuzz_random():
+--------------
+Returns the next number from an xorshift64* generator, so the --fuzz cases
+depend only on --seed.
 
-arg1: testList - A pointer to the TestFileList struct that holds all the 
-test information.
-arg2: index - The index of the specific test within the testList.
-arg3: stdoutFileName - The file name containing the expected standard output.
+arg1: state - The generator state, which must not be 0.
 
-Returns: None
-Errors: Exits with PROCESS_B_EXIT (exit status 98) if execlp fails.
+Returns: The next random number.
+Errors: None
 */
+uint64_t fuzz_random(uint64_t *state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 2685821657736338717ULL;
+}
 
-void compare_standard_out(TestFileList *testList, int index,
-char *stdoutFileName){
+/*
+fuzz_word():
+------------
+Makes a random word for a --fuzz case. Half the words are from the fuzz
+dictionary; the rest have a random length, and some have a character that
+isn't a letter.
 
-    //Redirect the standard input to the read end of the standardOutcmp pipe.
-    dup2(testList->tests[index].standardOutCmp[READ_END], STDIN_FILENO);
+arg1: state - The random generator state.
+arg2: dictionary - The words in the fuzz dictionary.
 
-    //Open a file descriptor for "/dev/null" for writing only.
-    int devNull = open("/dev/null", O_WRONLY);
-    //Redirect standard out and standard error to /dev/null.
-    dup2(devNull, STDOUT_FILENO);
-    dup2(devNull, STDERR_FILENO);
+Returns: The word, which the caller must free.
+Errors: None
+*/
+char *fuzz_word(uint64_t *state, char **dictionary) {
+    int kind = fuzz_random(state) % 4;
+    if (kind < 2) {
+        return strdup(dictionary[fuzz_random(state) % FUZZ_DICTIONARY_WORDS]);
+    }
+    char word[FUZZ_MAX_WORD_LENGTH + 1];
+    int length = 1 + fuzz_random(state) % FUZZ_MAX_WORD_LENGTH;
+    for (int i = 0; i < length; i++) {
+        word[i] = FUZZ_ALPHABET[fuzz_random(state) % strlen(FUZZ_ALPHABET)];
+    }
+    if (kind == 3) {
+        word[fuzz_random(state) % length] = FUZZ_BAD_CHARACTERS[
+                fuzz_random(state) % strlen(FUZZ_BAD_CHARACTERS)];
+    }
+    word[length] = '\0';
+    return strdup(word);
+}
 
-    //Close the file descriptors for the pipe ends, and /dev/null. 
-    close(devNull);
-    close(testList->tests[index].standardErrorCmp[READ_END]);
-    close(testList->tests[index].standardErrorCmp[WRITE_END]);
-    close(testList->tests[index].standardOutCmp[WRITE_END]);
-    close(testList->tests[index].standardErrorCmp[READ_END]);
+/*
+write_fuzz_dictionary():
+------------------------
+Generates the dictionary the --fuzz cases give with --dictionary, and
+writes it to a file.
 
-    //Use the execlp function to run the 'cmp' function.
-    execlp("cmp", "cmp", stdoutFileName, NULL); 
+arg1: fileName - The file to write the dictionary to.
+arg2: state - The random generator state.
+arg3: dictionary - Array of FUZZ_DICTIONARY_WORDS to hold the words.
 
-    //Exit if unsuccessful
-    _exit(PROCESS_B_EXIT);
+Returns: None
+Errors: Exits with exit status of 11 if the file can't be opened for
+        writing.
+*/
+void write_fuzz_dictionary(char *fileName, uint64_t *state,
+        char **dictionary) {
+    FILE *file = fopen(fileName, "w");
+    if (file == NULL) {
+        fprintf(stderr, "testuqwordladder: Can't open file \"%s\" for writing\n",
+                fileName);
+        exit(OPEN_FILE_ERROR);
+    }
+    char word[FUZZ_WORD_LENGTH + 1];
+    for (int i = 0; i < FUZZ_DICTIONARY_WORDS; i++) {
+        for (int j = 0; j < FUZZ_WORD_LENGTH; j++) {
+            word[j] = FUZZ_ALPHABET[fuzz_random(state)
+                    % strlen(FUZZ_ALPHABET)];
+        }
+        word[FUZZ_WORD_LENGTH] = '\0';
+        dictionary[i] = strdup(word);
+        fprintf(file, "%s\n", word);
+    }
+    fclose(file);
 }
 
 /*
-compare_standard_error():
--------------------------
-Compares the standard error of a test program with its expected standard error.
-It does this by running the 'cmp' program.
+fuzz_option_value():
+--------------------
+Makes a value for one of the options in a --fuzz case.
 
-arg1: testList - A pointer to the TestFileList struct that holds all the test
-information.
-arg2: index - The index of the specific test within the testList.
-arg3: stderrFileName - The file name containing the expected standard error.
+arg1: state - The random generator state.
+arg2: option - The option (FUZZ_START, etc.).
+arg3: valid - true for a value that good-uqwordladder accepts, false for a
+      random value that may not be.
+arg4: dictionary - The words in the fuzz dictionary.
+arg5: dictionaryNames - The fuzz dictionary file and a file that doesn't
+      exist.
 
-Returns: None (void)
-Errors: Exits with PROCESS_C_EXIT (exit status 99) if execlp fails.
+Returns: The value, which the caller must free.
+Errors: None
 */
-void compare_standard_error(TestFileList *testList, int index,
-char *stderrFileName){
-
-    //Redirect the standard input to the read end of the standErrorCmp pipe. 
-    dup2(testList->tests[index].standardErrorCmp[READ_END], STDIN_FILENO);
+char *fuzz_option_value(uint64_t *state, int option, bool valid,
+        char **dictionary, char **dictionaryNames) {
+    char number[FUZZ_MAX_WORD_LENGTH + 1];
+    switch (option) {
+        case FUZZ_START:
+        case FUZZ_END:
+            return valid ? strdup(dictionary[fuzz_random(state)
+                    % FUZZ_DICTIONARY_WORDS]) : fuzz_word(state, dictionary);
+        case FUZZ_LEN:
+            snprintf(number, sizeof(number), "%d", FUZZ_WORD_LENGTH);
+            return valid ? strdup(number) : strdup(fuzzNumbers[
+                    fuzz_random(state) % FUZZ_NUM_NUMBERS]);
+        case FUZZ_LIMIT:
+            snprintf(number, sizeof(number), "%d",
+                    1 + (int)(fuzz_random(state) % FUZZ_MAX_LINES));
+            return valid ? strdup(number) : strdup(fuzzNumbers[
+                    fuzz_random(state) % FUZZ_NUM_NUMBERS]);
+        default:
+            return strdup(dictionaryNames[!valid
+                    && fuzz_random(state) % 2 == 0]);
+    }
+}
 
-    //Open the /dev/null file descriptor for writing.
-    int devNull = open("/dev/null", O_WRONLY);
+/*
+generate_fuzz_case():
+---------------------
+Generates a random --fuzz case. It starts from a valid command line, with
+the options in a random order, and then makes up to FUZZ_MAX_MUTATIONS
+changes to it: replacing a value with a random one, leaving out an option,
+repeating an option, adding an unknown option or leaving out the last
+value. Up to FUZZ_MAX_LINES lines of standard input are added.
+
+arg1: state - The random generator state.
+arg2: dictionary - The words in the fuzz dictionary.
+arg3: dictionaryNames - The fuzz dictionary file and a file that doesn't
+      exist, for --dictionary.
+arg4: fuzzCase - The case to fill in.
 
-    //Redirect standard out and standard error to /dev/null.
-    dup2(devNull, STDOUT_FILENO);
-    dup2(devNull, STDERR_FILENO);
-    
-    //Close all file handlers: 
-    close(devNull);
-    close(testList->tests[index].standardErrorCmp[READ_END]);
-    close(testList->tests[index].standardErrorCmp[WRITE_END]);
-    close(testList->tests[index].standardOutCmp[WRITE_END]);
-    close(testList->tests[index].standardErrorCmp[READ_END]);
+Returns: None
+Errors: None
+*/
+void generate_fuzz_case(uint64_t *state, char **dictionary,
+        char **dictionaryNames, FuzzCase *fuzzCase) {
+    int options[FUZZ_NUM_OPTIONS];
+    for (int i = 0; i < FUZZ_NUM_OPTIONS; i++) {
+        int j = fuzz_random(state) % (i + 1);
+        options[i] = options[j];
+        options[j] = i;
+    }
+    fuzzCase->numArgs = 0;
+    bool giveLimit = fuzz_random(state) % 2;
+    for (int i = 0; i < FUZZ_NUM_OPTIONS; i++) {
+        if (options[i] != FUZZ_LIMIT || giveLimit) {
+            fuzzCase->args[fuzzCase->numArgs++] = strdup(
+                    fuzzOptions[options[i]]);
+            fuzzCase->args[fuzzCase->numArgs++] = fuzz_option_value(state,
+                    options[i], true, dictionary, dictionaryNames);
+        }
+    }
 
-    //Run the 'cmp' program through the execlp command. 
-    execlp("cmp", "cmp", stderrFileName, NULL);
+    int numMutations = fuzz_random(state) % (FUZZ_MAX_MUTATIONS + 1);
+    // Options and their values are in pairs until an unknown option is
+    // added or the last value is left out, which ends the changes.
+    for (int i = 0; i < numMutations && fuzzCase->numArgs >= 2
+            && fuzzCase->numArgs % 2 == 0; i++) {
+        int pair = fuzz_random(state) % (fuzzCase->numArgs / 2) * 2;
+        int option = fuzz_random(state) % FUZZ_NUM_OPTIONS;
+        switch (fuzz_random(state) % 5) {
+            case 0:
+                option = 0;
+                while (strcmp(fuzzCase->args[pair], fuzzOptions[option])) {
+                    option++;
+                }
+                free(fuzzCase->args[pair + 1]);
+                fuzzCase->args[pair + 1] = fuzz_option_value(state, option,
+                        false, dictionary, dictionaryNames);
+                break;
+            case 1:
+                free(fuzzCase->args[pair]);
+                free(fuzzCase->args[pair + 1]);
+                memmove(fuzzCase->args + pair, fuzzCase->args + pair + 2,
+                        (fuzzCase->numArgs - pair - 2) * sizeof(char *));
+                fuzzCase->numArgs -= 2;
+                break;
+            case 2:
+                fuzzCase->args[fuzzCase->numArgs++] = strdup(
+                        fuzzOptions[option]);
+                fuzzCase->args[fuzzCase->numArgs++] = fuzz_option_value(state,
+                        option, fuzz_random(state) % 2, dictionary,
+                        dictionaryNames);
+                break;
+            case 3:
+                fuzzCase->args[fuzzCase->numArgs++] = strdup("--bogus");
+                break;
+            default:
+                free(fuzzCase->args[--fuzzCase->numArgs]);
+                break;
+        }
+    }
 
-    //Exit if unsuccessful.
-    _exit(PROCESS_C_EXIT);
+    fuzzCase->numLines = fuzz_random(state) % (FUZZ_MAX_LINES + 1);
+    for (int i = 0; i < fuzzCase->numLines; i++) {
+        fuzzCase->lines[i] = fuzz_random(state) % 10 == 0
+                ? strdup("") : fuzz_word(state, dictionary);
+    }
 }
 
-
 /*
-is_sigkilled():
-----------------
-Checks if any child process was killed by a signal (SIGKILL) by
-iterating through an array of wait status and evaluating if a signal
-killed the child process.
+fuzz_case_without():
+--------------------
+Copies a --fuzz case with some of its arguments or lines of standard input
+left out, to try while minimising a divergence. The arguments and then the
+lines are numbered from 0.
 
-arg1: waitStatusArray - An array of wait statuses for the child processes.
-arg2: numChildren - The number of child processes.
+arg1: fuzzCase - The case to copy.
+arg2: omit - The first argument or line to leave out.
+arg3: count - The number of arguments or lines to leave out.
 
-Returns: true if any child process was killed by a signal; otherwise, false.
+Returns: The copy, which owns copies of the strings.
 Errors: None
 */
-bool is_sigkilled(int *waitStatusArray, int numChildren){
-
-    //Iterate through the wait status and check if any exited 
-    //through a signal (SIGKILL):
-    for (int i = 0; i < numChildren; i++){
-        if (WIFSIGNALED(waitStatusArray[i])){
-            return true;
+FuzzCase fuzz_case_without(FuzzCase *fuzzCase, int omit, int count) {
+    FuzzCase copy = {.numArgs = 0, .numLines = 0};
+    for (int i = 0; i < fuzzCase->numArgs; i++) {
+        if (i < omit || i >= omit + count) {
+            copy.args[copy.numArgs++] = strdup(fuzzCase->args[i]);
         }
     }
-    return false;
+    for (int i = 0; i < fuzzCase->numLines; i++) {
+        int number = fuzzCase->numArgs + i;
+        if (number < omit || number >= omit + count) {
+            copy.lines[copy.numLines++] = strdup(fuzzCase->lines[i]);
+        }
+    }
+    return copy;
 }
 
 /*
-is_exec_failed():
+free_fuzz_case():
 -----------------
-Checks if any child process failed to execute the exec command based on its
-exit status.
-
-arg1: waitStatusArray - An array of wait statuses for the child processes.
-arg2: numChildren - The number of child processes.
-arg3: testId - The ID of the test being run.
-
-Returns: true if any child process failed to execute; otherwise, false.
-Errors: Prints an error message to stdout if exec fails.
-*/
-bool is_exec_failed(int *waitStatusArray, int numChildren, char *testId){
-    //Check if each of the wait status of the child is the same
-    //as the exit statu under the exec call for that child. 
-    if (WEXITSTATUS(waitStatusArray[PROCESS_A_INDEX]) == PROCESS_A_EXIT ||
-        WEXITSTATUS(waitStatusArray[PROCESS_B_INDEX]) == PROCESS_B_EXIT ||
-        WEXITSTATUS(waitStatusArray[PROCESS_C_INDEX]) == PROCESS_C_EXIT){
-        printf("Unable to execute job %s\n", testId);
-        fflush(stdout);
-        return true;
+Frees the strings owned by a --fuzz case.
+*/
+void free_fuzz_case(FuzzCase *fuzzCase) {
+    for (int i = 0; i < fuzzCase->numArgs; i++) {
+        free(fuzzCase->args[i]);
+    }
+    for (int i = 0; i < fuzzCase->numLines; i++) {
+        free(fuzzCase->lines[i]);
     }
-
-    //If the execs of all child process succeeded, then return with false. 
-    return false; 
 }
 
-
 /*
-is_standard_out_error_matched():
---------------------------------
-Checks if the standard output and standard error of a test match
-the expected output and error.
+write_fuzz_input():
+-------------------
+Writes the standard input of a --fuzz case to a file.
 
-arg1: waitStatusArray - An array of wait statuses for the child processes.
-arg2: testId - The ID of the test being run.
+arg1: fileName - The file to write to.
+arg2: fuzzCase - The case.
 
-Returns: true if both standard output and standard error match; otherwise, 
-false.
-Errors: Prints a status message to stdout depending on the result of the 
-comparison.
+Returns: None
+Errors: Exits with exit status of 11 if the file can't be opened for
+        writing.
 */
-bool is_standard_out_error_matched(int *waitStatusArray, char *testId){
-    
-    bool standardOutMatched;
-    bool standardErrorMatched; 
-
-    int cmpStandardOut = WEXITSTATUS(waitStatusArray[PROCESS_B_INDEX]);
-    int cmpStandardError = WEXITSTATUS(waitStatusArray[PROCESS_C_INDEX]);
-
-    //Check if the status of process A is 0. 
-    if (cmpStandardOut == 0){
-        standardOutMatched = true; 
-        printf("Job %s: Stdout matches\n", testId);
-        fflush(stdout);
+void write_fuzz_input(char *fileName, FuzzCase *fuzzCase) {
+    FILE *file = fopen(fileName, "w");
+    if (file == NULL) {
+        fprintf(stderr, "testuqwordladder: Can't open file \"%s\" for writing\n",
+                fileName);
+        exit(OPEN_FILE_ERROR);
     }
-
-    else if (cmpStandardOut == 1){
-        standardOutMatched = false; 
-        printf("Job %s: Stdout differs\n", testId);
-        fflush(stdout);
+    for (int i = 0; i < fuzzCase->numLines; i++) {
+        fprintf(file, "%s\n", fuzzCase->lines[i]);
     }
+    fclose(file);
+}
 
-    if (cmpStandardError == 0){
-        standardErrorMatched = true; 
-        printf("Job %s: Stderr matches\n", testId);
-        fflush(stdout);
-    }
+/*
+run_fuzz_cases():
+-----------------
+Runs --fuzz cases as tests: good-uqwordladder generates the expected outputs
+and the program is compared with them in memory, --jobs cases at a time,
+exactly as for the tests in a job file.
+
+arg1: parameters - The command line arguments, with dir set to the directory
+      the cases are run in.
+arg2: cases - The cases to run.
+arg3: numCases - The number of cases.
+arg4: prefix - The start of the test IDs given to the cases.
+arg5: diverged - Set to whether the program's output, error output or exit
+      status differed from good-uqwordladder's for each case.
 
-       else if (cmpStandardError == 1){
-        standardErrorMatched = false; 
-        printf("Job %s: Stderr differs\n", testId);
-        fflush(stdout);
+Returns: None
+Errors: Exits with exit status of 11 if an input file can't be written.
+*/
+void run_fuzz_cases(CommandLineArgs *parameters, FuzzCase *cases,
+        int numCases, char *prefix, bool *diverged) {
+    TestFileList testList = {.numTests = 0, .capacity = 0, .tests = NULL};
+    char testId[NAME_MAX], inputFileName[PATH_MAX];
+    char *fields[FUZZ_MAX_ARGS + 3];
+    for (int i = 0; i < numCases; i++) {
+        snprintf(testId, sizeof(testId), "%s-%d", prefix, i);
+        snprintf(inputFileName, PATH_MAX, "%s/%s.in", parameters->dir, testId);
+        write_fuzz_input(inputFileName, &cases[i]);
+        fields[0] = testId;
+        fields[1] = inputFileName;
+        memcpy(fields + 2, cases[i].args, cases[i].numArgs * sizeof(char *));
+        fields[cases[i].numArgs + 2] = NULL;
+        IndividualTest test = create_new_individual_test(fields);
+        test.timeoutMs = 0;
+        add_individual_test(test, &testList);
     }
 
-    if (standardOutMatched && standardErrorMatched){
-        return true;
+    generating_expected_outputs(parameters, &testList);
+    running_tests_job_real(&testList, parameters);
+    for (int i = 0; i < numCases; i++) {
+        diverged[i] = !testList.tests[i].passed;
+        unlink(testList.tests[i].testInputFileName);
+        free(testList.tests[i].testArgs);
     }
-    
-    else{
-    return false;
+    free(testList.tests);
+    if (testList.pack != NULL) {
+        munmap(testList.pack, testList.packSize);
     }
-
 }
 
-
-
 /*
-is_exit_status_matched():
--------------------------
-Checks if the exit status of a test matches the expected exit status.
+minimise_fuzz_case():
+---------------------
+Shrinks a --fuzz case that diverged by repeatedly making the first of these
+smaller cases that still diverges: leaving out two adjacent arguments (an
+option and its value), then leaving out a single argument or line of
+standard input. It stops when none of them diverge. Each round runs all the
+smaller cases at once.
 
-arg1: waitStatusArray - An array of wait statuses for the child processes.
-arg2: goodWaitStatus - The expected exit status.
-arg3: testId - The ID of the test being run.
+arg1: parameters - The command line arguments, as for run_fuzz_cases().
+arg2: fuzzCase - The case, which is replaced by the smallest case found.
 
-Returns: true if the exit status matches; otherwise, false.
-Errors: Prints a status message to stdout.
+Returns: None
+Errors: As for run_fuzz_cases().
 */
-bool is_exit_status_matched(int *waitStatusArray, int goodWaitStatus,
-    char *testId){
-
-    int childExitStatus = WEXITSTATUS(waitStatusArray[PROCESS_A_INDEX]);
-    if (childExitStatus == goodWaitStatus){
-        printf("Job %s: Exit status matches\n", testId);
-        fflush(stdout);
-        return true;
-    }
-    
-        else {
-            printf("Job %s: Exit status differs\n", testId);
-            fflush(stdout);
-            return false;
+void minimise_fuzz_case(CommandLineArgs *parameters, FuzzCase *fuzzCase) {
+    int smaller = 0;
+    while (smaller != -1) {
+        int numPairs = fuzzCase->numArgs ? fuzzCase->numArgs - 1 : 0;
+        int numVariants = numPairs + fuzzCase->numArgs + fuzzCase->numLines;
+        if (numVariants == 0) {
+            return;
         }
+        FuzzCase *variants = malloc(numVariants * sizeof(FuzzCase));
+        bool *diverged = malloc(numVariants * sizeof(bool));
+        for (int i = 0; i < numVariants; i++) {
+            variants[i] = i < numPairs ? fuzz_case_without(fuzzCase, i, 2)
+                    : fuzz_case_without(fuzzCase, i - numPairs, 1);
+        }
+        run_fuzz_cases(parameters, variants, numVariants, "shrink", diverged);
 
+        smaller = -1;
+        for (int i = 0; i < numVariants; i++) {
+            if (smaller == -1 && diverged[i]) {
+                smaller = i;
+            } else {
+                free_fuzz_case(&variants[i]);
+            }
+        }
+        if (smaller != -1) {
+            free_fuzz_case(fuzzCase);
+            *fuzzCase = variants[smaller];
+        }
+        free(variants);
+        free(diverged);
+    }
 }
 
-
- 
-
 /*
-running_tests_job_real():
--------------------------
-Responsible for running each test job in the tests array of the testFileList
-structure. It forks three child processes for each test. The first child
-process runs the test program, the second child process compares the standard
-output, and the third child process compares the standard error. 
-The parent waits on the children to finish, and then checks the exit status.
+read_job_file_ids():
+--------------------
+Reads the test IDs already in the job file, if it exists, without checking
+the rest of each line.
 
-arg1: testList - Pointer to the TestFileList struct containing the list of tests.
-arg2: parameters - Pointer to CommandLineArgs struct with command-line arguments.
+arg1: jobFile - The path of the job file.
+arg2: testIds - The empty set to add the IDs to. It owns the IDs added, which
+      free_job_file_ids() frees.
 
 Returns: None
 Errors: None
 */
-void running_tests_job_real(TestFileList *testList, CommandLineArgs *parameters) {
-    // Loop through the testFileList:
-    char *testProgram = parameters->program;
-    //Initialize the number of tests completed to 0 and passed.
-    testList->testsCompleted = 0;
-    testList->testsPassed = 0;
-
-    for (int i = 0; i < testList->numTests; i++) {
-        // Initialize the pipes for the standard out and standard error.
-        pipe(testList->tests[i].standardOutCmp);
-        pipe(testList->tests[i].standardErrorCmp);
-        // Flush the standard out with the message:
-        printf("Running job: %s\n", testList->tests[i].testID);
-
-        // Initialize the pids for the children:
-        int numChildren = 3;
-        pid_t pidArray[numChildren];
-        int waitStatusArray[numChildren];
-
-        // Fork three times:
-        for (int j = 0; j < numChildren; j++) {
-            // Get the name of the expected output file for standard output and standard error.
-            int buffer = 100;
-            char stdoutFileName[100], stderrFileName[100];
-            snprintf(stdoutFileName, buffer, "%s/%s.stdout", parameters->dir, testList->tests[i].testID);
-            snprintf(stderrFileName, buffer, "%s/%s.stderr", parameters->dir, testList->tests[i].testID);
-
-            // This will get the childPIDs and store them in an array.
-            pid_t childPid = fork();
-            // Code for child processes:
-            if (childPid == 0) {
-                // In process A: Run the test_program file the standard 
-                //out/error pipes. 
-                if (j == 0) {
-                    run_test_program(testList,testProgram, i); 
-                }
-                // In process 2 (B): Compare the standard output. 
-                if (j == 1) {
-                    compare_standard_out(testList, i, stdoutFileName);
-                }
-
-                // In process 3 (C): Compare the standard error. 
-                if (j == 2) {
-                    compare_standard_error(testList, i, stderrFileName);
-                }
-            }
-
-            pidArray[j] = childPid;
+void read_job_file_ids(char *jobFile, StringSet *testIds) {
+    FILE *file = fopen(jobFile, "r");
+    char *line;
+    while (file != NULL && (line = read_line(file)) != NULL) {
+        line[strcspn(line, "\t")] = '\0';
+        if (comment_empty_line_check(line) || !string_set_add(testIds, line)) {
+            free(line);
         }
-   
-        close(testList->tests[i].standardErrorCmp[READ_END]);
-        close(testList->tests[i].standardErrorCmp[WRITE_END]);
-        close(testList->tests[i].standardOutCmp[READ_END]);
-        close(testList->tests[i].standardOutCmp[WRITE_END]);
-
-        struct timespec processSleep;
-        processSleep.tv_sec = 1;
-        processSleep.tv_nsec = 500000000L;
-        nanosleep(&processSleep, NULL);
+    }
+    if (file != NULL) {
+        fclose(file);
+    }
+}
 
-        // Send SIGKILL to each child process
-        for (int i = 0; i < numChildren; i++) {
-            kill(pidArray[i], SIGKILL);
-        }
+/*
+free_job_file_ids():
+--------------------
+Frees a set of test IDs read by read_job_file_ids().
 
-        // In the parent process, iterate throught the pidArray, and wait for them:
-        for (int i = 0; i < numChildren; i++) {
-            int waitStatus;
-            //Wait for the child to finish.
-            waitpid(pidArray[i], &waitStatus, 0);
-            //Put the wait stauts in the wait status array. 
-            waitStatusArray[i] = waitStatus;
-    
-        }
+arg1: testIds - The set to free.
 
-        //Increment the number of jobs completed by one:
-        testList->testsCompleted++;
+Returns: None
+*/
+void free_job_file_ids(StringSet *testIds) {
+    for (size_t i = 0; i < testIds->capacity; i++) {
+        free(testIds->slots[i]);
+    }
+    free(testIds->slots);
+}
 
-        //Check if the test have failed thrugh a signal: 
-        if (is_sigkilled(waitStatusArray, numChildren) == true){
-            continue; 
-        }
+/*
+append_fuzz_job():
+------------------
+Adds a job line reproducing a --fuzz divergence to the job file, and prints
+it. The case's standard input is kept in the fuzz directory. A case whose
+test ID is already in the job file (from an earlier run with the same
+--seed) is only printed, so the job file never gets a duplicate ID.
 
-        //Check if any of the execs failed for the child processes.
-        else if (is_exec_failed(waitStatusArray, numChildren,
-        testList->tests[i].testID) == true){
-            continue; 
-        }
+arg1: parameters - The command line arguments.
+arg2: fuzzDir - The directory the fuzz files are kept in.
+arg3: caseNumber - The number of the case.
+arg4: fuzzCase - The (minimised) case.
+arg5: testIds - The test IDs in the job file. The new ID is added to it.
 
-        bool standardOutErrorMatched = is_standard_out_error_matched(waitStatusArray,
-        testList->tests[i].testID);
-        bool exitStatusMatched = is_exit_status_matched(waitStatusArray,
-        testList->tests[i].goodExitStatus, testList->tests[i].testID);
+Returns: None
+Errors: Exits with exit status of 11 if the job file or input file can't be
+        written.
+*/
+void append_fuzz_job(CommandLineArgs *parameters, char *fuzzDir,
+        int caseNumber, FuzzCase *fuzzCase, StringSet *testIds) {
+    char testId[NAME_MAX], inputFileName[PATH_MAX];
+    snprintf(testId, sizeof(testId), "fuzz-%d-%d", parameters->fuzzSeed,
+            caseNumber);
+    snprintf(inputFileName, PATH_MAX, "%s/%s.in", fuzzDir, testId);
+    char *newId = strdup(testId);
+    if (!string_set_add(testIds, newId)) {
+        free(newId);
+        printf("Divergence %s: already in \"%s\"\n", testId,
+                parameters->jobFile);
+        return;
+    }
+    write_fuzz_input(inputFileName, fuzzCase);
 
-        if (standardOutErrorMatched == false || exitStatusMatched == false){
-            continue;
-        }
-    
-        else {
-            testList->testsPassed++;
-        }
-    
+    FILE *jobFile = fopen(parameters->jobFile, "a");
+    if (jobFile == NULL) {
+        fprintf(stderr, "testuqwordladder: Can't open file \"%s\" for writing\n",
+                parameters->jobFile);
+        exit(OPEN_FILE_ERROR);
+    }
+    fprintf(jobFile, "%s\t%s", testId, inputFileName);
+    printf("Divergence %s:", testId);
+    for (int i = 0; i < fuzzCase->numArgs; i++) {
+        fprintf(jobFile, "\t%s", fuzzCase->args[i]);
+        printf(" %s", fuzzCase->args[i]);
     }
+    fprintf(jobFile, "\n");
+    printf(" < %s\n", inputFileName);
+    fclose(jobFile);
 }
 
-
 /*
-report_on_test_jobs():
-----------------------
-Generates a report on the number of tests passed and completed. It also determines
-the overall exit status of the program based on these numbers.
+run_fuzzing():
+--------------
+Runs --fuzz: generates the random cases from --seed, runs them against the
+program and good-uqwordladder, then minimises each case that diverged and
+appends it to the job file. The fuzz files are kept in the "fuzz"
+subdirectory of --dir, so the expected outputs of the job file's own tests
+are left alone.
 
-arg1: testList - Pointer to the TestFileList struct containing the list of tests.
+arg1: parameters - The command line arguments.
 
-Returns: None
-Errors: Exits with exit status 0 if all tests passed; otherwise, exits with
-exit status 7.
+Returns: None (This function exits the program)
+Errors: Exits with exit status 7 if any case diverged, otherwise 0.
 */
-void report_on_test_jobs(TestFileList *testList){
-    //If at least one test has been completed, print the result: 
-    if (testList->testsCompleted > 0){
-        int testsPassed = testList->testsPassed;
-        int testsCompleted = testList->testsCompleted;
-        printf("testuqwordladder: %d of %d tests passes\n", testsPassed, testsCompleted);
-    
-        //If all test have passed exit with stautus 0: 
-        if (testsPassed == testsCompleted){
-            exit(OVERALL_TEST_RESULT_PASS);
-        }
+void run_fuzzing(CommandLineArgs *parameters) {
+    char fuzzDir[PATH_MAX], dictionaryName[PATH_MAX], missingName[PATH_MAX];
+    make_test_directory(parameters->dir);
+    snprintf(fuzzDir, PATH_MAX, "%s/fuzz", parameters->dir);
+    make_test_directory(fuzzDir);
+    snprintf(dictionaryName, PATH_MAX, "%s/fuzz/fuzz-%d.dict",
+            parameters->dir, parameters->fuzzSeed);
+    snprintf(missingName, PATH_MAX, "%s/fuzz/missing.dict", parameters->dir);
+    char *dictionaryNames[2] = {dictionaryName, missingName};
+
+    uint64_t state = FNV_OFFSET_BASIS ^ (uint64_t)parameters->fuzzSeed
+            * FNV_PRIME;
+    char *dictionary[FUZZ_DICTIONARY_WORDS];
+    write_fuzz_dictionary(dictionaryName, &state, dictionary);
+    FuzzCase *cases = malloc(parameters->fuzzCases * sizeof(FuzzCase));
+    bool *diverged = malloc(parameters->fuzzCases * sizeof(bool));
+    for (int i = 0; i < parameters->fuzzCases; i++) {
+        generate_fuzz_case(&state, dictionary, dictionaryNames, &cases[i]);
+    }
 
-        else{
-            exit(OVERALL_TEST_RESULT_FAIL);
+    parameters->dir = fuzzDir;
+    parameters->quiet = true;
+    parameters->showDiff = 0;
+    parameters->prioritise = false;
+    parameters->failFast = false;
+    run_fuzz_cases(parameters, cases, parameters->fuzzCases, "case", diverged);
+    int numDiverged = 0;
+    StringSet testIds = {calloc(64, sizeof(char *)), 64, 0};
+    read_job_file_ids(parameters->jobFile, &testIds);
+    for (int i = 0; i < parameters->fuzzCases; i++) {
+        if (diverged[i]) {
+            minimise_fuzz_case(parameters, &cases[i]);
+            append_fuzz_job(parameters, fuzzDir, i, &cases[i], &testIds);
+            numDiverged++;
         }
+        free_fuzz_case(&cases[i]);
+    }
+    free_job_file_ids(&testIds);
+    for (int i = 0; i < FUZZ_DICTIONARY_WORDS; i++) {
+        free(dictionary[i]);
     }
+    free(cases);
+    free(diverged);
 
+    printf("testuqwordladder: %d of %d fuzz cases diverged\n", numDiverged,
+            parameters->fuzzCases);
+    exit(numDiverged ? OVERALL_TEST_RESULT_FAIL : OVERALL_TEST_RESULT_PASS);
 }
 
-
 int main(int argc, char *argv[]) {
     CommandLineArgs parameters;
     TestFileList testList;
+    if (argc > 1 && strcmp(argv[1], "--merge") == 0) {
+        merge_results_reports(argc, argv);
+    }
     command_line_arguments(argc, argv, &parameters);
+    if (parameters.fuzzCases > 0) {
+        run_fuzzing(&parameters);
+    }
     job_specification_file(&parameters, &testList);
+    if (parameters.shardCount > 0) {
+        select_shard_tests(&parameters, &testList);
+    }
     generating_expected_outputs(&parameters, &testList);
-    running_tests_job(&testList, &parameters); 
     running_tests_job_real(&testList, &parameters);
+    testList.benchRegressions = 0;
+    if (parameters.benchRuns > 0) {
+        run_benchmarks(&testList, &parameters);
+    }
+    if (parameters.report != NULL) {
+        write_results_report(&parameters, &testList);
+    }
     report_on_test_jobs(&testList);
 
     